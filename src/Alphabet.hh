@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+/*
+  An alphabet maps the bytes of a word to symbol codes 0..size-1. The trie
+  levels and the compressed formats work in codes, so a dictionary is not
+  tied to the letters a-z.
+
+  Alpha26 is the fast path for English: the code is c - 'a', there is no
+  table, and the text of the hash maps is stored as the letters themselves.
+
+  ByteAlphabet handles everything else: accented letters (each byte of a
+  UTF-8 sequence is a symbol), apostrophes, digits. Symbols are ranked by
+  frequency when the dictionary is built so the most common ones get the
+  smallest codes, and the table is stored in the header of the dictionary
+  file. Text is stored as codes, which is why there can be at most 127
+  symbols: the high bit of each byte still marks the end of a word.
+
+  Both have the same interface so the dictionaries are specialized at compile
+  time and the 26 letter path pays nothing for the generality.
+*/
+class Alpha26 {
+ public:
+  static constexpr uint32_t size = 26;
+  static constexpr bool remaps = false;  // text is stored as the raw bytes
+
+  // the code for c, or -1 if c is not in the alphabet
+  static int32_t index(uint8_t c) {
+    uint32_t d = c - 'a';
+    return d < size ? int32_t(d) : -1;
+  }
+  static uint8_t textCode(uint8_t c) { return c; }
+  static uint8_t symbol(uint32_t code) { return 'a' + code; }
+  static uint8_t fromText(uint8_t t) { return t; }
+
+  static uint32_t headerSize() { return 0; }
+  static const void *header() { return nullptr; }
+  static uint32_t read(const char[]) { return 0; }
+};
+
+template <uint32_t N = 64>
+class ByteAlphabet {
+  static_assert(N < 128, "codes are stored with the high bit marking the end");
+
+ private:
+  // this is the header in the file, followed by the table itself
+  struct alignas(8) Header {
+    uint32_t count;        // number of symbols in use
+    uint8_t symbols[N];    // symbols[code] is the byte, most frequent first
+  };
+  Header h;
+  int8_t codes[256];  // codes[byte] = code or -1 if not in the alphabet
+
+ public:
+  static constexpr uint32_t size = N;
+  static constexpr bool remaps = true;  // text is stored as codes
+
+  ByteAlphabet() {
+    memset(&h, 0, sizeof(h));
+    memset(codes, -1, sizeof(codes));
+  }
+
+  /*
+    Rank every byte that appears in a word (anything above space) by how
+    often it occurs in buf.
+  */
+  void build(const char buf[], uint64_t len) {
+    uint64_t freq[256] = {0};
+    for (uint64_t i = 0; i < len; i++) freq[uint8_t(buf[i])]++;
+    uint8_t order[256];
+    uint32_t count = 0;
+    for (uint32_t c = ' ' + 1; c < 256; c++)
+      if (freq[c] != 0) order[count++] = c;
+    if (count > N) throw "too many distinct symbols for alphabet";
+    std::stable_sort(order, order + count, [&freq](uint8_t a, uint8_t b) {
+      return freq[a] > freq[b];
+    });
+    h.count = count;
+    memcpy(h.symbols, order, count);
+    setCodes();
+  }
+
+  int32_t index(uint8_t c) const { return codes[c]; }
+  uint8_t textCode(uint8_t c) const { return codes[c]; }
+  uint8_t symbol(uint32_t code) const { return h.symbols[code]; }
+  uint8_t fromText(uint8_t t) const { return h.symbols[t]; }
+  uint32_t count() const { return h.count; }
+
+  static uint32_t headerSize() { return sizeof(Header); }
+  const void *header() const { return &h; }
+  uint32_t read(const char header[]) {
+    memcpy(&h, header, sizeof(h));
+    setCodes();
+    return sizeof(h);
+  }
+
+ private:
+  void setCodes() {
+    memset(codes, -1, sizeof(codes));
+    for (uint32_t i = 0; i < h.count; i++) codes[h.symbols[i]] = i;
+  }
+};
+
+/*
+  The set of symbols following a trie node, with the rank of a symbol in the
+  set giving the position of its child. 26 letters fit in one 32-bit word;
+  wider alphabets use as many 64-bit words as needed.
+*/
+template <uint32_t N, bool Narrow = (N <= 32)>
+class SymbolSet;
+
+template <uint32_t N>
+class SymbolSet<N, true> {
+ private:
+  uint32_t bits;
+
+ public:
+  SymbolSet() : bits(0) {}
+  void set(uint32_t code) { bits |= 1U << code; }
+  bool has(uint32_t code) const { return (bits >> code) & 1; }
+  // number of symbols in the set below code
+  uint32_t rank(uint32_t code) const {
+    return __builtin_popcount(bits & ((1U << code) - 1));
+  }
+};
+
+template <uint32_t N>
+class SymbolSet<N, false> {
+ private:
+  uint64_t bits[(N + 63) / 64];
+
+ public:
+  SymbolSet() { memset(bits, 0, sizeof(bits)); }
+  void set(uint32_t code) { bits[code >> 6] |= 1ULL << (code & 63); }
+  bool has(uint32_t code) const { return (bits[code >> 6] >> (code & 63)) & 1; }
+  uint32_t rank(uint32_t code) const {
+    uint32_t r = 0;
+    for (uint32_t i = 0; i < (code >> 6); i++)
+      r += __builtin_popcountll(bits[i]);
+    return r + __builtin_popcountll(bits[code >> 6] &
+                                    ((1ULL << (code & 63)) - 1));
+  }
+};
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+  Read a file into memory in the background, a chunk at a time, so a huge
+  dictionary can start serving before the whole image is in.
+
+  The reads go through io_uring, driven by one thread with up to depth reads
+  in flight. If the kernel has no io_uring (or it is disabled, as it often
+  is in containers) a pool of threads calling pread does the same job. The
+  raw system calls are used so there is no dependency on liburing.
+
+  Chunks are read in file order, except that demand() moves the chunks
+  covering a range ahead of the rest, more so the more often they are asked
+  for. A lookup that finds its data missing demands it, so the pages the
+  queries actually touch are read first. ready() is lock free and can be
+  called on every lookup; waitFor() blocks until a range is in.
+
+  The buffer is only valid where ready() says so.
+*/
+class AsyncLoader {
+ private:
+  enum : uint8_t { PENDING, READING, LOADED };
+
+  int fh;
+  uint64_t size;
+  std::unique_ptr<char[]> buf;
+  uint32_t chunkSize;
+  uint32_t numChunks;
+  std::unique_ptr<std::atomic<uint8_t>[]> state;
+  std::vector<uint32_t> demands;  // times each chunk was asked for
+  // (demands, -chunk): most demanded first, then in file order. Entries
+  // whose count is out of date are skipped when popped
+  std::priority_queue<std::pair<uint32_t, int64_t>> queue;
+  std::mutex m;
+  std::condition_variable loadedOne;
+  std::atomic<uint32_t> remaining;
+  std::atomic<bool> stopping;
+  const char *error;
+  bool uring;
+  std::vector<std::thread> threads;
+
+  // the io_uring rings, if in use
+  struct Ring {
+    int fd = -1;
+    io_uring_params p;
+    void *sq = MAP_FAILED, *cq = MAP_FAILED;
+    size_t sqLen = 0, cqLen = 0;
+    io_uring_sqe *sqes = (io_uring_sqe *)MAP_FAILED;
+    uint32_t *sqTail, *sqMask, *sqArray;
+    uint32_t *cqHead, *cqTail, *cqMask;
+    io_uring_cqe *cqes;
+  } ring;
+
+  uint64_t chunkOffset(uint32_t i) const { return uint64_t(i) * chunkSize; }
+  uint32_t chunkLen(uint32_t i) const {
+    return std::min<uint64_t>(chunkSize, size - chunkOffset(i));
+  }
+
+  // the next chunk to read, or -1 when there are none left
+  int64_t next() {
+    std::lock_guard<std::mutex> lock(m);
+    while (!stopping && !queue.empty()) {
+      std::pair<uint32_t, int64_t> e = queue.top();
+      queue.pop();
+      uint32_t i = -e.second;
+      if (state[i] != PENDING || e.first != demands[i]) continue;
+      state[i] = READING;
+      return i;
+    }
+    return -1;
+  }
+  void finish(uint32_t i, bool ok) {
+    std::lock_guard<std::mutex> lock(m);
+    if (ok) {
+      state[i].store(LOADED, std::memory_order_release);
+      remaining--;
+    } else if (error == nullptr) {
+      error = "Error reading dictionary file";
+      stopping = true;
+    }
+    loadedOne.notify_all();
+  }
+
+  void preadChunks() {
+    for (int64_t i; (i = next()) >= 0;) {
+      uint64_t off = chunkOffset(i), len = chunkLen(i), got = 0;
+      while (got < len) {
+        ssize_t n = pread(fh, buf.get() + off + got, len - got, off + got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += n;
+      }
+      finish(i, got == len);
+    }
+  }
+
+  static int uringSetup(uint32_t entries, io_uring_params *p) {
+    return syscall(__NR_io_uring_setup, entries, p);
+  }
+  static int uringEnter(int fd, uint32_t submit, uint32_t wait) {
+    return syscall(__NR_io_uring_enter, fd, submit, wait,
+                   IORING_ENTER_GETEVENTS, nullptr, 0);
+  }
+  // set up the rings, false if io_uring cannot be used here
+  bool openRing(uint32_t depth) {
+    memset(&ring.p, 0, sizeof(ring.p));
+    ring.fd = uringSetup(depth, &ring.p);
+    if (ring.fd < 0) return false;
+    // IORING_OP_READ needs 5.6, FAST_POLL arrived in 5.7
+    if ((ring.p.features & IORING_FEAT_FAST_POLL) == 0) return false;
+    const io_uring_params &p = ring.p;
+    ring.sqLen = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    ring.cqLen = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) ring.sqLen = ring.cqLen = std::max(ring.sqLen, ring.cqLen);
+    ring.sq = mmap(nullptr, ring.sqLen, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+    if (ring.sq == MAP_FAILED) return false;
+    ring.cq = single ? ring.sq
+                     : mmap(nullptr, ring.cqLen, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring.fd,
+                            IORING_OFF_CQ_RING);
+    if (ring.cq == MAP_FAILED) return false;
+    ring.sqes = (io_uring_sqe *)mmap(
+        nullptr, p.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+    if (ring.sqes == MAP_FAILED) return false;
+    char *sq = (char *)ring.sq, *cq = (char *)ring.cq;
+    ring.sqTail = (uint32_t *)(sq + p.sq_off.tail);
+    ring.sqMask = (uint32_t *)(sq + p.sq_off.ring_mask);
+    ring.sqArray = (uint32_t *)(sq + p.sq_off.array);
+    ring.cqHead = (uint32_t *)(cq + p.cq_off.head);
+    ring.cqTail = (uint32_t *)(cq + p.cq_off.tail);
+    ring.cqMask = (uint32_t *)(cq + p.cq_off.ring_mask);
+    ring.cqes = (io_uring_cqe *)(cq + p.cq_off.cqes);
+    return true;
+  }
+  void closeRing() {
+    if (ring.sqes != MAP_FAILED)
+      munmap(ring.sqes, ring.p.sq_entries * sizeof(io_uring_sqe));
+    if (ring.cq != MAP_FAILED && ring.cq != ring.sq)
+      munmap(ring.cq, ring.cqLen);
+    if (ring.sq != MAP_FAILED) munmap(ring.sq, ring.sqLen);
+    if (ring.fd >= 0) ::close(ring.fd);
+    ring = Ring();
+  }
+
+  // queue a read of the rest of chunk i, got bytes are already in
+  void submitRead(uint32_t i, uint32_t got) {
+    uint32_t tail = *ring.sqTail;  // only this thread writes it
+    uint32_t slot = tail & *ring.sqMask;
+    io_uring_sqe *sqe = &ring.sqes[slot];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fh;
+    sqe->addr = (uint64_t)(buf.get() + chunkOffset(i) + got);
+    sqe->len = chunkLen(i) - got;
+    sqe->off = chunkOffset(i) + got;
+    sqe->user_data = i;
+    ring.sqArray[slot] = slot;
+    __atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+  }
+
+  void uringChunks(uint32_t depth) {
+    std::vector<uint32_t> got(numChunks, 0);
+    uint32_t inflight = 0, toSubmit = 0;
+    for (;;) {
+      for (int64_t i; inflight < depth && (i = next()) >= 0; inflight++) {
+        submitRead(i, 0);
+        toSubmit++;
+      }
+      if (inflight == 0) break;
+      int r = uringEnter(ring.fd, toSubmit, 1);
+      if (r < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        // nothing more can complete, so fail what is outstanding
+        for (uint32_t i = 0; i < numChunks; i++)
+          if (state[i] == READING) finish(i, false);
+        break;
+      }
+      if (r > 0) toSubmit -= r;
+      uint32_t head = *ring.cqHead;
+      uint32_t tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+      for (; head != tail; head++) {
+        const io_uring_cqe &cqe = ring.cqes[head & *ring.cqMask];
+        uint32_t i = cqe.user_data;
+        if (cqe.res > 0) got[i] += cqe.res;
+        if (cqe.res > 0 && got[i] < chunkLen(i)) {
+          submitRead(i, got[i]);  // short read, ask for the rest
+          toSubmit++;
+          continue;
+        }
+        finish(i, got[i] == chunkLen(i));
+        inflight--;
+      }
+      __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+    }
+  }
+
+ public:
+  /*
+    Start reading filename. threads is the size of the pread pool, used only
+    if io_uring is unavailable or useUring is false.
+  */
+  explicit AsyncLoader(const char filename[], uint32_t chunkSize = 1 << 20,
+                       uint32_t depth = 32, uint32_t threads = 4,
+                       bool useUring = true)
+      : chunkSize(chunkSize), stopping(false), error(nullptr), uring(false) {
+    fh = ::open(filename, O_RDONLY);
+    if (fh < 0) throw "Could not open dictionary file";
+    struct stat st;
+    fstat(fh, &st);
+    size = st.st_size;
+    buf.reset(new char[size]);
+    numChunks = (size + chunkSize - 1) / chunkSize;
+    state.reset(new std::atomic<uint8_t>[numChunks]);
+    demands.assign(numChunks, 0);
+    for (uint32_t i = 0; i < numChunks; i++) {
+      state[i] = PENDING;
+      queue.emplace(0, -int64_t(i));
+    }
+    remaining = numChunks;
+    posix_fadvise(fh, 0, size, POSIX_FADV_SEQUENTIAL);
+    if (useUring && openRing(depth)) {
+      uring = true;
+      this->threads.emplace_back([this, depth] { uringChunks(depth); });
+    } else {
+      closeRing();
+      for (uint32_t t = 0; t < threads; t++)
+        this->threads.emplace_back([this] { preadChunks(); });
+    }
+  }
+  ~AsyncLoader() {
+    stopping = true;  // threads finish the reads in flight and return
+    for (std::thread &t : threads) t.join();
+    closeRing();
+    ::close(fh);
+  }
+  AsyncLoader(const AsyncLoader &) = delete;
+  AsyncLoader &operator=(const AsyncLoader &) = delete;
+
+  const char *data() const { return buf.get(); }
+  uint64_t fileSize() const { return size; }
+  bool usingUring() const { return uring; }
+  bool done() const { return remaining.load(std::memory_order_acquire) == 0; }
+
+  // true if every byte of [offset, offset+len) has been read
+  bool ready(uint64_t offset, uint64_t len) const {
+    if (len == 0 || offset >= size || done()) return true;
+    uint32_t last = (std::min(offset + len, size) - 1) / chunkSize;
+    for (uint32_t i = offset / chunkSize; i <= last; i++)
+      if (state[i].load(std::memory_order_acquire) != LOADED) return false;
+    return true;
+  }
+  // read the chunks of [offset, offset+len) ahead of everything asked less
+  void demand(uint64_t offset, uint64_t len) {
+    if (len == 0 || offset >= size) return;
+    uint32_t last = (std::min(offset + len, size) - 1) / chunkSize;
+    std::lock_guard<std::mutex> lock(m);
+    for (uint32_t i = offset / chunkSize; i <= last; i++)
+      if (state[i] == PENDING) queue.emplace(++demands[i], -int64_t(i));
+  }
+  // block until [offset, offset+len) is in, throwing if a read failed
+  void waitFor(uint64_t offset, uint64_t len) {
+    demand(offset, len);
+    std::unique_lock<std::mutex> lock(m);
+    loadedOne.wait(lock,
+                   [&] { return error != nullptr || ready(offset, len); });
+    if (error != nullptr) throw error;
+  }
+  // block until the whole file is in
+  void wait() { waitFor(0, size); }
+};
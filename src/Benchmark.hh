@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+  Timing for the benchmarks. A measurement runs a workload for a number of
+  trials and keeps the time per operation of every trial, so results are
+  reported as a distribution (min, median, p90, max) rather than one run of
+  clock() ticks. Each result is printed as a table row for people and as a
+  line of JSON for scripts tracking regressions.
+
+  The workload returns a checksum (a sum of ids, a count of words found) that
+  is printed too, so the compiler cannot drop the work, and a change in the
+  answer shows up next to a change in speed.
+*/
+class Benchmark {
+ public:
+  struct Result {
+    std::string bench;            // what was measured, eg lookup_hit
+    std::string impl;             // what it was measured on
+    uint64_t ops;                 // operations per trial
+    std::vector<double> nsPerOp;  // one per trial, sorted
+    uint64_t check;               // checksum returned by the workload
+
+    double percentile(double p) const {
+      if (nsPerOp.empty()) return 0;
+      double pos = p / 100 * (nsPerOp.size() - 1);
+      uint32_t i = uint32_t(pos);
+      if (i + 1 >= nsPerOp.size()) return nsPerOp.back();
+      return nsPerOp[i] + (pos - i) * (nsPerOp[i + 1] - nsPerOp[i]);
+    }
+    double mean() const {
+      double sum = 0;
+      for (double v : nsPerOp) sum += v;
+      return nsPerOp.empty() ? 0 : sum / nsPerOp.size();
+    }
+  };
+
+ private:
+  std::ostream &json;
+  std::ostream &human;
+  bool headerPrinted;
+
+ public:
+  Benchmark(std::ostream &json, std::ostream &human)
+      : json(json), human(human), headerPrinted(false) {}
+
+  // time one call of f in nanoseconds, f returns its checksum in check
+  template <typename Func>
+  static double time(Func f, uint64_t &check) {
+    auto t0 = std::chrono::steady_clock::now();
+    check = f();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count();
+  }
+
+  /*
+    Run f trials times, with setup() before each trial outside the timing.
+    ops is the number of operations f does, used to scale to ns/op.
+  */
+  template <typename Setup, typename Func>
+  Result run(const char bench[], const char impl[], uint64_t ops,
+             uint32_t trials, Setup setup, Func f) {
+    Result r{bench, impl, ops, {}, 0};
+    for (uint32_t t = 0; t < trials; t++) {
+      setup();
+      r.nsPerOp.push_back(time(f, r.check) / std::max<uint64_t>(ops, 1));
+    }
+    std::sort(r.nsPerOp.begin(), r.nsPerOp.end());
+    report(r);
+    return r;
+  }
+  template <typename Func>
+  Result run(const char bench[], const char impl[], uint64_t ops,
+             uint32_t trials, Func f) {
+    return run(bench, impl, ops, trials, [] {}, f);
+  }
+
+  void report(const Result &r) {
+    if (!headerPrinted) {
+      human << std::left << std::setw(20) << "bench" << std::setw(26)
+            << "impl" << std::right << std::setw(10) << "ops" << std::setw(12)
+            << "min ns/op" << std::setw(12) << "p50" << std::setw(12) << "p90"
+            << std::setw(12) << "max" << '\n';
+      headerPrinted = true;
+    }
+    human << std::left << std::setw(20) << r.bench << std::setw(26) << r.impl
+          << std::right << std::setw(10) << r.ops << std::fixed
+          << std::setprecision(2) << std::setw(12) << r.percentile(0)
+          << std::setw(12) << r.percentile(50) << std::setw(12)
+          << r.percentile(90) << std::setw(12) << r.percentile(100) << '\n';
+    json << std::setprecision(6) << "{\"bench\":\"" << r.bench
+         << "\",\"impl\":\"" << r.impl << "\",\"ops\":" << r.ops
+         << ",\"trials\":" << r.nsPerOp.size()
+         << ",\"min_ns_op\":" << r.percentile(0)
+         << ",\"p50_ns_op\":" << r.percentile(50)
+         << ",\"p90_ns_op\":" << r.percentile(90)
+         << ",\"p99_ns_op\":" << r.percentile(99)
+         << ",\"max_ns_op\":" << r.percentile(100)
+         << ",\"mean_ns_op\":" << r.mean() << ",\"check\":" << r.check
+         << "}\n";
+  }
+
+  // a measurement that is a size rather than a time
+  void reportBytes(const char bench[], const char impl[], uint64_t bytes,
+                   uint64_t words) {
+    human << std::left << std::setw(20) << bench << std::setw(26) << impl
+          << std::right << std::setw(10) << words << std::setw(12) << bytes
+          << " bytes, " << std::fixed << std::setprecision(2)
+          << double(bytes) / words << " bytes/word\n";
+    json << "{\"bench\":\"" << bench << "\",\"impl\":\"" << impl
+         << "\",\"words\":" << words << ",\"bytes\":" << bytes
+         << ",\"bytes_per_word\":" << std::setprecision(6)
+         << double(bytes) / words << "}\n";
+  }
+};
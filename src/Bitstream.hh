@@ -25,7 +25,7 @@ class Bitstream {
       bitpos += len;
     } else {
       *current++ |= (v << bitpos);
-      *current = v >> remaining;
+      *current = v >> (remaining - 1) >> 1;  // remaining may be 64
       bitpos = len - remaining;
     }
   }
@@ -38,17 +38,15 @@ class Bitstream {
   */
   uint64_t read(uint32_t len) {
     uint32_t remaining = 64 - bitpos;
-    if (remaining >= len) {
-      uint64_t v = (*current >> bitpos) & (0xFFFFFFFFFFFFFFFFULL >> (64 - len));
+    uint64_t v = *current >> bitpos;
+    if (len < remaining) {
       bitpos += len;
-      return v;
-    } else {
-      uint64_t v =
-          (*current++ >> bitpos) & (0xFFFFFFFFFFFFFFFFULL >> (64 - len));
+    } else {  // on to the next word, reading it only if the value goes on
+      current++;
       bitpos = len - remaining;
-      v |= *current & (0xFFFFFFFFFFFFFFFFULL >> (64 - bitpos));
-      return v;
+      if (bitpos != 0) v |= *current << remaining;
     }
+    return v & (0xFFFFFFFFFFFFFFFFULL >> (64 - len));
   }
   friend std::ostream &operator<<(std::ostream &s, const Bitstream &b) {
     s << std::hex;
@@ -73,7 +71,7 @@ class BitIterator {
       bitpos += len;
     } else {
       *word++ |= (v << bitpos);
-      *word = v >> remaining;
+      *word |= v >> (remaining - 1) >> 1;  // remaining may be 64
       bitpos = len - remaining;
     }
   }
@@ -84,14 +82,14 @@ class BitIterator {
   void replace(uint64_t v, uint32_t len) {
     uint32_t remaining = 64 - bitpos;  // bits remaining in current word
     uint64_t mask = 0xFFFFFFFFFFFFFFFFULL >> (64 - len);
+    *word = (*word & ~(mask << bitpos)) | (v << bitpos);
     if (len < remaining) {
-      *word = *word & (mask << bitpos) | (v << bitpos);
       bitpos += len;
     } else {
-      *word = *word & (mask << bitpos) | (v << bitpos);
       ++word;
-      *word = *word & (0xFFFFFFFFFFFFFFFFULL >> remaining) | (v >> remaining);
       bitpos = len - remaining;
+      if (bitpos != 0)  // the rest, leaving the bits after it
+        *word = (*word & (0xFFFFFFFFFFFFFFFFULL << bitpos)) | (v >> remaining);
     }
   }
   void operator-=(uint32_t pos) {
@@ -113,16 +111,15 @@ class BitIterator {
   */
   uint64_t read(uint32_t len) {
     uint32_t remaining = 64 - bitpos;
-    if (remaining >= len) {
-      uint64_t v = (*word >> bitpos) & (0xFFFFFFFFFFFFFFFFULL >> (64 - len));
+    uint64_t v = *word >> bitpos;
+    if (len < remaining) {
       bitpos += len;
-      return v;
-    } else {
-      uint64_t v = (*word++ >> bitpos) & (0xFFFFFFFFFFFFFFFFULL >> (64 - len));
+    } else {  // on to the next word, reading it only if the value goes on
+      word++;
       bitpos = len - remaining;
-      v |= *word & (0xFFFFFFFFFFFFFFFFULL >> (64 - bitpos));
-      return v;
+      if (bitpos != 0) v |= *word << remaining;
     }
+    return v & (0xFFFFFFFFFFFFFFFFULL >> (64 - len));
   }
   const uint64_t *endPointer() const {
     if (bitpos == 0) return word;
@@ -0,0 +1,376 @@
+#pragma once
+
+/*
+ Compressed format:
+First 3 letters index into list of hash maps
+aaa --> bin 1, list how many 64-bit blocks of words are in this hash map
+aab --> bin 2, list number of blocks...
+zzz --> bin 17500
+
+approximately 17500 bins total. The problem is most have size 0, some have size
+3000. numbers are 12 bits, so the header is 17500 * 1.5 bytes
+Each bin starts on a fresh block (the rest of the last block of a bin is 0)
+so the start of any bin is the sum of the counts before it, and every bin can
+be decoded on its own.
+
+This is wasteful but at least is simple.
+We store the words in a single list arithmetically encoded with base 27
+code 26 means end of word. 13 letters fit into a single 64-bit word. The first 3
+letters are removed. Only words longer than 2 letters are stored.
+The alphabet, the number of letters removed and the bits per count are
+template parameters, and the packing constants follow from the alphabet size
+(see PackedSymbols.hh).
+
+This is not a "real" dictionary format but is being implemented quickly just to
+compare to the better one in CompressedDict.cc
+
+        words are inserted using arithmetic encoding
+        example: aa, aal, aalii, aam, aani, aardvark, aardwolf, aaronic,
+aaronical, aaronite, aaronitic, aaru
+
+        l END lii END m END ni END rdvark END rdwolf END ronic END ronical END
+ronite END ronitic END ru END
+
+bdeh END bua END c END ca END cate END cay END cinate END cination END
+
+        57 tokens = 57/13 = 4+1 = 5*8 = 40 bytes
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "Alphabet.hh"
+#include "Bitstream.hh"
+#include "DictFile.hh"
+#include "PackedSymbols.hh"
+#include "Tokenizer.hh"
+
+template <typename Alphabet = Alpha26, uint32_t hashSizeBits = 12,
+          uint32_t PrefixLen = 3>
+class CompressedDict {
+ private:
+  using Packing = SymbolPacking<Alphabet::size>;
+  static constexpr uint32_t power(uint32_t b, uint32_t n) {
+    return n == 0 ? 1 : b * power(b, n - 1);
+  }
+  static constexpr uint32_t FIRST_N = power(Alphabet::size, PrefixLen);
+  static constexpr uint32_t maxNodeSize = (1 << hashSizeBits) - 1;
+  static constexpr uint32_t headerWords = (FIRST_N * hashSizeBits + 63) / 64;
+
+  Alphabet alphabet;
+  uint64_t *bitMem;
+  Bitstream bits;
+  const char *dict;
+  uint32_t dictLen;
+  std::vector<uint64_t> compressedWords;
+  SymbolPacker<Alphabet::size> packer;
+  uint32_t nextBin;     // the next bin whose count has not been written
+  uint32_t firstBlock;  // the first block of the bin being written
+  int32_t lastBin;      // the bin being written, -1 before the first
+
+  // the number of the first PrefixLen letters, or -1 if any is not a symbol
+  int32_t whichBin(const char w[]) const {
+    int32_t which = 0, bad = 0;
+    for (uint32_t i = 0; i < PrefixLen; i++) {
+      int32_t c = alphabet.index(w[i]);
+      bad |= c;
+      which = which * Alphabet::size + c;
+    }
+    return bad < 0 ? -1 : which;
+  }
+
+  // finish the current bin and write zero counts for empty bins before bin
+  void endBins(uint32_t bin) {
+    packer.flush();
+    if (nextBin < bin) {
+      uint32_t blocks = compressedWords.size() - firstBlock;
+      if (blocks > maxNodeSize) throw "bin too big for hashSizeBits";
+      bits.write(blocks, hashSizeBits);
+      for (nextBin++; nextBin < bin; nextBin++) bits.write(0, hashSizeBits);
+    }
+    firstBlock = compressedWords.size();
+  }
+  void startBin(uint32_t bin) {
+    if (int32_t(bin) == lastBin) return;
+    if (int32_t(bin) < lastBin || bin >= FIRST_N)
+      throw "dictionary must be sorted";
+    endBins(bin);
+    lastBin = bin;
+  }
+
+  void writeOneWord(uint32_t start, uint32_t end) {
+    for (uint32_t i = start + PrefixLen; i < end; i++) {
+      int32_t c = alphabet.index(dict[i]);
+      if (c < 0) throw "letter not within alphabet";
+      packer.put(c);
+    }
+    packer.put(Packing::END);  // end the word with a special token
+  }
+
+ public:
+  CompressedDict(const char filename[])
+      : bitMem(new uint64_t[headerWords + 1]),
+        bits(bitMem),
+        packer(compressedWords),
+        nextBin(0),
+        firstBlock(0),
+        lastBin(-1) {
+    std::ifstream f(filename);
+    if (!f) throw "Could not open dictionary";
+    f.seekg(0, std::ios::end);  // go to the end
+    dictLen = f.tellg();
+    compressedWords.reserve(dictLen / Packing::perWord + 2);
+    f.seekg(0, std::ios::beg);  // go back to the beginning
+    dict = new char[dictLen];
+    f.read((char *)dict, dictLen);  // read the whole file into the buffer
+    if constexpr (Alphabet::remaps) alphabet.build(dict, dictLen);
+
+    // the words must be sorted, so each bin is one run of the file
+    Tokenizer<NON_SPACE> tok(dict, dictLen);
+    for (Tokenizer<NON_SPACE>::Span w; tok.next(w);) {
+      if (w.len < PrefixLen) continue;  // short words are not stored
+      int32_t which = whichBin(dict + w.start);
+      if (which < 0) throw "prefix letters not within alphabet";
+      startBin(which);
+      writeOneWord(w.start, w.start + w.len);
+    }
+    endBins(FIRST_N);
+    delete[] dict;
+  }
+  /*
+    An empty dictionary to fill with add() and copyBin(), bin by bin in
+    order, like DictMerge.hh does; writeCompressed() ends it.
+  */
+  CompressedDict(const Alphabet &alphabet)
+      : alphabet(alphabet),
+        bitMem(new uint64_t[headerWords + 1]),
+        bits(bitMem),
+        packer(compressedWords),
+        nextBin(0),
+        firstBlock(0),
+        lastBin(-1) {}
+  ~CompressedDict() { delete[] bitMem; }
+  CompressedDict(const CompressedDict &) = delete;
+
+  // add a word by the codes after its prefix, in order
+  void add(uint32_t bin, const uint8_t codes[], uint32_t len) {
+    startBin(bin);
+    for (uint32_t i = 0; i < len; i++) packer.put(codes[i]);
+    packer.put(Packing::END);
+  }
+  // a whole bin of packed words as a CompressedDictReader has it
+  void copyBin(uint32_t bin, const uint64_t blocks[], uint32_t n) {
+    startBin(bin);
+    packer.flush();
+    compressedWords.insert(compressedWords.end(), blocks, blocks + n);
+  }
+
+  static constexpr uint64_t layout() {
+    return uint64_t(Alphabet::size) | uint64_t(hashSizeBits) << 8 |
+           uint64_t(PrefixLen) << 16;
+  }
+  // the bin counts and the words as sections of a DictFile
+  void writeCompressed(const char filename[]) {
+    endBins(FIRST_N);
+    DictFileWriter w(DICT_COMPRESSED3, layout());
+    if (alphabet.headerSize() != 0)
+      w.add(SECTION_ALPHABET, alphabet.header(), alphabet.headerSize());
+    w.add(SECTION_COMPRESSED_HEADER, bitMem, headerWords * sizeof(uint64_t));
+    w.add(SECTION_COMPRESSED_WORDS, compressedWords.data(),
+          compressedWords.size() * sizeof(uint64_t));
+    w.write(filename);
+  }
+};
+
+/*
+  Read a file written by CompressedDict::writeCompressed. The header counts
+  are summed once into the first block of every bin, then any bin can be
+  decoded on its own, so the bins can be decoded by as many threads as
+  there are. This is the Source that BasicTrieHashDict::loadBins takes.
+*/
+template <typename Alphabet = Alpha26, uint32_t hashSizeBits = 12,
+          uint32_t PrefixLen = 3>
+class CompressedDictReader {
+ private:
+  using Packing = SymbolPacking<Alphabet::size>;
+  using Writer = CompressedDict<Alphabet, hashSizeBits, PrefixLen>;
+  static constexpr uint32_t power(uint32_t b, uint32_t n) {
+    return n == 0 ? 1 : b * power(b, n - 1);
+  }
+
+  DictFileReader file;
+  Alphabet alphabet;
+  const uint64_t *words;
+  uint64_t countBytes;               // of the header of bin counts
+  uint32_t wordCount;
+  std::vector<uint32_t> firstBlock;  // of each bin, and the end of the last
+  std::vector<uint32_t> firstId;     // of the first word of each bin
+  static constexpr uint32_t MAX_SUFFIX = 256;
+
+  // the bin of word and the codes after its prefix, -1 if it has no bin
+  int32_t encode(const char word[], uint32_t len, uint8_t target[]) const {
+    if (len < PrefixLen || len - PrefixLen > MAX_SUFFIX) return -1;
+    int32_t bin = 0;
+    for (uint32_t i = 0; i < len; i++) {
+      int32_t c = alphabet.index(word[i]);
+      if (c < 0) return -1;
+      if (i < PrefixLen)
+        bin = bin * Alphabet::size + c;
+      else
+        target[i - PrefixLen] = c;
+    }
+    return bin;
+  }
+
+ public:
+  static constexpr uint32_t FIRST_N = power(Alphabet::size, PrefixLen);
+  static constexpr uint32_t prefixLen = PrefixLen;
+
+  CompressedDictReader(const char filename[])
+      : firstBlock(FIRST_N + 1), firstId(FIRST_N) {
+    file.open(filename, DICT_COMPRESSED3, Writer::layout());
+    uint64_t len;
+    if (alphabet.headerSize() != 0) {
+      const char *p = file.section(SECTION_ALPHABET, len);
+      if (len != alphabet.headerSize()) throw "Dictionary file is corrupt";
+      alphabet.read(p);
+    }
+    const uint64_t *counts =
+        (const uint64_t *)file.section(SECTION_COMPRESSED_HEADER, len);
+    if (len < (uint64_t(FIRST_N) * hashSizeBits + 63) / 64 * 8)
+      throw "Dictionary file is corrupt";
+    countBytes = len;
+    words = (const uint64_t *)file.section(SECTION_COMPRESSED_WORDS, len);
+    uint64_t numBlocks = len / sizeof(uint64_t), sum = 0;
+    for (uint32_t b = 0; b < FIRST_N; b++) {
+      firstBlock[b] = sum;
+      uint64_t bit = uint64_t(b) * hashSizeBits;
+      uint64_t v = counts[bit / 64] >> bit % 64;
+      if (bit % 64 + hashSizeBits > 64)
+        v |= counts[bit / 64 + 1] << (64 - bit % 64);
+      sum += v & ((1ULL << hashSizeBits) - 1);
+    }
+    if (sum != numBlocks) throw "Dictionary file is corrupt";
+    firstBlock[FIRST_N] = sum;
+    // ids start at 1 and follow the words in order, as loadBins gives them
+    uint32_t id = 1;
+    uint8_t digits[Packing::perWord];
+    for (uint32_t b = 0; b < FIRST_N; b++) {
+      firstId[b] = id;
+      for (uint32_t i = firstBlock[b]; i < firstBlock[b + 1]; i++) {
+        Packing::unpack(words[i], digits);
+        for (uint8_t d : digits) id += d == Packing::END;
+      }
+    }
+    wordCount = id - 1;
+  }
+
+  const Alphabet &getAlphabet() const { return alphabet; }
+  bool verify() const { return file.verifyAll(); }
+  uint32_t numWords() const { return wordCount; }
+  uint64_t headerBytes() const { return countBytes; }
+  uint64_t wordBytes() const { return firstBlock[FIRST_N] * sizeof(uint64_t); }
+  uint64_t blocks(uint32_t bin) const {
+    return firstBlock[bin + 1] - firstBlock[bin];
+  }
+  // the packed words of bin, blocks(bin) of them
+  const uint64_t *binWords(uint32_t bin) const {
+    return words + firstBlock[bin];
+  }
+
+  /*
+    Call f(const uint8_t codes[], uint32_t len) with the suffix of every
+    word of bin, in order. The codes are the letters after the prefix.
+  */
+  template <typename Func>
+  void forEachSuffix(uint32_t bin, Func f) const {
+    PackedWordCursor<Alphabet::size> c(words + firstBlock[bin],
+                                       words + firstBlock[bin + 1]);
+    const uint8_t *word;
+    for (uint32_t len; c.next(word, len);) f(word, len);
+  }
+
+  /*
+    Look a word up by decoding its bin, setting id to what loadBins would
+    give it. The bin is decoded as far as the first word not before the
+    target, each word compared whole with memcmp. Slow beside a
+    TrieHashDict all the same; put a LookupCache in front for text that
+    repeats, or look many words up at once with getBatch.
+  */
+  bool get(const char word[], uint32_t len, uint32_t &id) const {
+    uint8_t target[MAX_SUFFIX];
+    int32_t bin = encode(word, len, target);
+    if (bin < 0) return false;
+    PackedWordCursor<Alphabet::size> c(words + firstBlock[bin],
+                                       words + firstBlock[bin + 1]);
+    const uint8_t *w;
+    uint32_t n = len - PrefixLen;
+    for (uint32_t rel = 0, wlen; c.next(w, wlen); rel++) {
+      int32_t cmp = compareCodes(w, wlen, target, n);
+      if (cmp == 0) {
+        id = firstId[bin] + rel;
+        return true;
+      }
+      if (cmp > 0) return false;  // the bin is sorted, so it is not there
+    }
+    return false;
+  }
+
+  /*
+    Look up n words at once, setting ids[i] to the id of queries[i], or 0
+    if it is not in the dictionary, like TrieHashDict::getBatch. The words
+    are sorted by bin and then by their codes, and each bin is decoded once
+    for all the words in it, as far as the last of them, walking the bin
+    and the words together like a merge. Returns the number found. Being
+    const it can run on many threads at once, as CorpusPipeline does.
+  */
+  uint32_t getBatch(const char *const queries[], const uint32_t lens[],
+                    uint32_t n, uint32_t ids[]) const {
+    struct Query {
+      uint32_t bin, start, len, i;
+    };
+    std::vector<Query> sorted;
+    std::vector<uint8_t> codes;
+    sorted.reserve(n);
+    uint8_t target[MAX_SUFFIX];
+    for (uint32_t i = 0; i < n; i++) {
+      ids[i] = 0;
+      int32_t bin = encode(queries[i], lens[i], target);
+      if (bin < 0) continue;
+      sorted.push_back({uint32_t(bin), uint32_t(codes.size()),
+                        lens[i] - PrefixLen, i});
+      codes.insert(codes.end(), target, target + lens[i] - PrefixLen);
+    }
+    const uint8_t *c = codes.data();
+    std::sort(sorted.begin(), sorted.end(),
+              [c](const Query &a, const Query &b) {
+                return a.bin != b.bin ? a.bin < b.bin
+                                      : compareCodes(c + a.start, a.len,
+                                                     c + b.start, b.len) < 0;
+              });
+    uint32_t found = 0;
+    for (size_t q = 0; q < sorted.size();) {
+      uint32_t bin = sorted[q].bin, rel = 0, wlen = 0;
+      PackedWordCursor<Alphabet::size> cursor(words + firstBlock[bin],
+                                              words + firstBlock[bin + 1]);
+      const uint8_t *w = nullptr;
+      bool more = cursor.next(w, wlen);
+      for (; q < sorted.size() && sorted[q].bin == bin; q++) {
+        const Query &x = sorted[q];
+        int32_t cmp = 1;
+        while (more && (cmp = compareCodes(w, wlen, c + x.start, x.len)) < 0) {
+          more = cursor.next(w, wlen);
+          rel++;
+        }
+        if (more && cmp == 0) {
+          ids[x.i] = firstId[bin] + rel;
+          found++;
+        }
+      }
+    }
+    return found;
+  }
+};
@@ -94,267 +94,68 @@ letters i and u)
 spare for future expansion
 */
 
-#include <cstring>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
-//#include <string>
+#include <random>
+#include <string>
 #include <vector>
 
-#include "Bitstream.hh"
+#include "Benchmark.hh"
+#include "CompressedDict1.hh"
 using namespace std;
 
-class CompressedDict1 {
- private:
-  /*
-    TODO: for convenience we need plenty of state in here while recursively
-    creating the dictionary. This class is needed while compressing, but the
-    dictionary retained in memory should not have this state.
-  */
-  uint64_t *bitMem;
-  BitIterator bits;
-  const char *dict;
-  uint32_t dictLen;
-  vector<uint64_t> compressedWords;
-  uint64_t current;
-  uint64_t power;
-
-  static constexpr uint32_t hashSizeBits = 4;
-  static constexpr uint32_t maxNodeSize = 1 << hashSizeBits;
-  static constexpr uint64_t base = 27;
-  static constexpr uint64_t base2 = base * base;
-  static constexpr uint64_t base4 = base2 * base2;
-  static constexpr uint64_t base8 = base4 * base4;
-
-  static constexpr uint64_t baseto12 = base8 * base4;
-  static constexpr uint8_t END = base - 1;
-  static constexpr uint8_t END2 = base - 2;
-  /*
-1* ('a'-'a') = 0
-   27*('b'-'a') = 27
-   27*27 *('d'-'a') = 3*27*27=2187
-
-*/
-  inline void writeOneChar(uint8_t code) {
-    if (power < baseto12) {
-      current += code * power;
-      power *= base;
-    } else {
-      current += code * power;
-      compressedWords.push_back(current);
-      power = 1;
-      current = 0;
-    }
-  }
-
-  void writeOneWord(uint32_t &dictIndex, uint32_t prefixLen) {
-    for (uint32_t i = 0; i < prefixLen; i++)
-      if (dict[dictIndex] < 'a' || dict[dictIndex] > 'z') {
-        cerr << "Error: prefix letters not within alphabet" << endl;
-        return;
-      }
-    dictIndex += prefixLen;
-    uint8_t c;
-    while ((c = dict[dictIndex++]) >= 'a' && c <= 'z') {
-      // write each letter of the word in base 27 or 28, 13 characters per 64
-      // bit word
-      writeOneChar(c - 'a');
-    }
-    writeOneChar(END);  // end the word with a special token
-    while (dictIndex < dictLen &&
-           dict[dictIndex] <= ' ')  // skip whitespace until next word
-      dictIndex++;
-  }
-  inline bool comparePrefix(const char prefix[], uint32_t prefixLen,
-                            uint32_t dictIndex) {
-    for (uint32_t k = 0; k < prefixLen; k++) {
-      if (prefix[k] != dict[dictIndex + k]) return false;
-    }
-    return true;
-  }
-
-  inline uint32_t countThisPrefix(char prefix[], uint32_t prefixLen,
-                                  uint32_t dictIndex) {
-    uint32_t countWordsThisPrefix = 0;
-    for (uint32_t j = dictIndex; j < dictLen;) {
-      if (comparePrefix(prefix, prefixLen, j)) {
-        countWordsThisPrefix++;
-        j += prefixLen;
-        if (countWordsThisPrefix > maxNodeSize)
-          return countWordsThisPrefix;  // too big, so stop counting so the
-                                        // caller can split and recurse
-        else
-          ;
-        // skip to next word
-        while (j < dictLen && dict[j] >= 'a' && dict[j] <= 'z')
-          j++;  // skip remaining letters in word
-        while (j < dictLen && dict[j] <= ' ')
-          j++;  // skip whitespace after word
-      } else {
-        break;
-      }
-    }
-    return countWordsThisPrefix;
-  }
+static void report(const char name[], const CompressedDict1<>::Plan &p,
+                   uint32_t words) {
+  cerr << name << ": " << p.trieNodes << " trie nodes, " << p.buckets
+       << " buckets (" << fixed << setprecision(2)
+       << double(words) / max(p.buckets, 1U) << " words mean, "
+       << p.largestBucket << " max), predicted " << p.headerBits / 8
+       << " header + " << uint64_t(p.wordBits / 8) << " word bytes, "
+       << setprecision(1) << p.work << " nodes+symbols per lookup\n";
+}
 
- public:
-  /*
-search through the file for all words starting with prefix[] with prefixLen
-characters. if the number of words <= maxNodeSize end recursion by writing out
-the hash node and problem: in order to write this node, we need to know how many
-children there are. So we will have to search once to get all the letters under
-this one, and then recurse The other alternative (faster) is to allocate the
-space for the bits of the trie node, not knowing what they are, recurse, return
-the bits and then go back and write them.
+/*
+  usage: CompressedDict [dict.txt] [workWeight] [dict.bin]
+  Plans dict.txt with the fixed split threshold and then adaptively, at
+  workWeight bytes per symbol decoded per lookup, writing each and timing
+  lookups of every word against what the cost model predicted. The
+  adaptive layout is the one left in dict.bin.
 */
-  CompressedDict1(const char filename[])
-      : bitMem(new uint64_t[12000]), bits(bitMem, 0) {
+int main(int argc, char *argv[]) {
+  const char *dictFile = argc > 1 ? argv[1] : "../dict.txt";
+  double workWeight = argc > 2 ? atof(argv[2]) : 2000;
+  const char *out = argc > 3 ? argv[3] : "dict.bin";
+  try {
+    CompressedDict1<> dict(dictFile);
+    vector<string> queries;
     {
-      ifstream f(filename);
-      f.seekg(0, std::ios::end);  // go to the end
-      dictLen = f.tellg();
-      compressedWords.reserve(dictLen / 13 + 2);
-      // compressedWords.push_back(0);
-      f.seekg(0, std::ios::beg);  // go back to the beginning
-      dict = new char[dictLen];
-      f.read((char *)dict, dictLen);  // read the whole file into the buffer
+      ifstream f(dictFile);
+      for (string w; f >> w;) queries.push_back(w);
+      shuffle(queries.begin(), queries.end(), mt19937(1));
     }
-    /*
-current prefix, should only need about 4-6 of these characters.
-64 is overkill. At each point count how many words begin with this string
-if too many (>k, perhaps k = 100 or 150) then split the group with
-another level of trie.
-For our sample dictionary of 213k words, 2000 prefixes means no single
-group requires > 107 words, keeping each section small and removing
-a maximal number of letters from the front of the dictionary.
-*/
-    char prefix[16] = {0};
-    uint32_t countWordsThisPrefix = 0;
-    uint32_t prefixLen = 1;
-    // start with 1 letter prefixes and recurse every time any node has too
-    // many (words > 128)
-    uint32_t dictIndex = 0;
-    // at the start of the dictionary, first skip potential spaces...
-    current = 0;
-    power = 1;
-    for (char first = 'a'; first <= 'z'; first++) {
-      prefix[0] = first;
-      uint32_t index = recursiveFindPrefix(prefix, 1, dictIndex);
+    Benchmark b(cout, cerr);
+    for (bool adaptive : {false, true}) {
+      const char *name = adaptive ? "CompressedDict1 adaptive"
+                                  : "CompressedDict1 fixed";
+      report(name, dict.plan(workWeight, adaptive), dict.numWords());
+      dict.writeCompressed(out);
+      CompressedDict1Reader<> r(out);
+      uint64_t work = 0, found = 0;
+      for (const string &w : queries) found += r.get(w.data(), w.size(), work);
+      cerr << name << ": measured " << r.headerBytes() << " header + "
+           << r.wordBytes() << " word bytes, " << setprecision(1)
+           << double(work) / queries.size() << " nodes+symbols per lookup, "
+           << found << " of " << queries.size() << " found\n";
+      b.run("lookup_hit", name, queries.size(), 5, [&r, &queries] {
+        uint64_t work = 0, found = 0;
+        for (const string &w : queries)
+          found += r.get(w.data(), w.size(), work);
+        return found;
+      });
     }
-    delete[] dict;
-  }
-
-  ~CompressedDict1() { delete[] bitMem; }
-  void displayCompressedWord(uint64_t w) {
-    for (int i = 0; i < 13; i++) {
-      uint8_t c = w % base;
-      cout << (c < END ? (char)(c + 'a') : ' ');
-      w /= base;
-    }
-    cout << flush;
-  }
-
-  uint8_t recursiveFindPrefix(char prefix[], uint32_t prefixLen,
-                              uint32_t &dictIndex) {
-    // find each letter after the current prefix, ie for a --> aa, ab, ac,
-    // ad ...
-    // TODO: load prefix
-    uint32_t count;
-    uint32_t childBits = 0;
-    if ((count = countThisPrefix(prefix, prefixLen, dictIndex)) > maxNodeSize) {
-      // too many, split up by considering one more letter prefix
-      BitIterator parentBits = bits;
-      uint32_t isWord = uint32_t(dict[dictIndex + prefixLen] < ' ');
-      bits.orBits((1 << 27) | (isWord << 26), 28);
-
-      // for each letter under this prefix, aa, ab, ac, ...
-      for (uint32_t i = dictIndex; i < dictLen;) {
-        // make the new prefix the one we are looking for
-        // the last character in the word: (check if wordLen == prefixLen)
-        if (!comparePrefix(prefix, prefixLen, i)) {
-          dictIndex = i;
-          // TODO: is this right? at the end of all words starting with
-          // prefix... ex aba.. or in the bits from the child?
-          // aba has child values 0xab92e which is true for _bcd _f__ i__l mn_p
-          // _rst    hex should be e instead of a? a- vxz not correct at all.
-          parentBits.orBits(childBits, 26);
-          return 0;
-        }
-        if (dict[i + prefixLen] <= ' ') {
-          i += prefixLen;
-          while (dict[i] >= 'a' && dict[i] <= 'z') i++;
-          while (dict[i] <= ' ') i++;
-        }
-
-        prefix[prefixLen] = dict[i + prefixLen];
-        uint8_t childChar = recursiveFindPrefix(prefix, prefixLen + 1, i);
-        if (prefix[0] == 'z' && prefix[1] == 'y' && prefix[2] == 'z') {
-          parentBits.orBits(childBits, 26);
-          return 0;
-        }
-        if (childChar != 0) childBits |= (1 << (childChar - 'a'));
-
-        // the i= in for loop skips forward past this prefix to the next one
-      }
-      parentBits.orBits(childBits, 26);
-      return prefix[prefixLen - 1];
-    } else {
-      uint32_t isWord = uint32_t(dict[dictIndex + prefixLen] < ' ');
-      // encode this hash node 0 isWord count count=7 bits at the moment
-      bits.orBits((isWord << hashSizeBits) | count, hashSizeBits + 2);
-      // append all words to the list of arithmetic-encoded without the prefix
-      // uint32_t childBits = 0;
-      for (int k = 0; k < prefixLen; k++) cerr << prefix[k];
-      cerr << "\t" << count << endl;
-      for (uint32_t j = 0; j < count; j++) {
-        // childBits |= 1 << (dict[dictIndex+prefixLen]);
-        writeOneWord(dictIndex, prefixLen);
-      }
-      return prefix[prefixLen - 1];
-    }
-  }
-
-  void writeCompressed(const char filename[]) {
-    ofstream bin(filename, ios::binary);
-    bin.write((char *)bitMem, (bits.endPointer() - bitMem) * sizeof(uint64_t));
-
-    bin.write((char *)&compressedWords[0],
-              compressedWords.size() * sizeof(uint64_t));
-#if 0
-    for (uint32_t i = 0; i < compressedWords.size(); i++)
-      displayCompressedWord(compressedWords[i]);
-#endif
-    ofstream bin2("words.bin", ios::binary);
-    bin2.write((char *)&compressedWords[0],
-               compressedWords.size() * sizeof(uint64_t));
-  }
-#if 0
-  // read the compressed words back from a binary file
-  void readCompressed(ifstream &in) {
-    uint64_t buffer[256];
-    uint32_t len = 0;
-    while (in.read((char *)buffer, sizeof(buffer))) {
-      //			cout << "len=" << len;
-      for (uint32_t i = 0; i < 256; i++) {
-        uint64_t current = buffer[i];
-        for (uint32_t j = 0; j < 13; j++) {
-          uint8_t c = current % base;
-          cout << (c < (base - 1) ? (char)(c + 'a') : ' ');
-          current /= base;
-        }
-      }
-    }
-  }
-#endif
-};
-
-int main() {
-  CompressedDict1 dict("../dict.txt");
-  dict.writeCompressed("dict.bin");
-#if 0
-	{
-    ifstream bin("dict.bin");
-    CompressedDict1 dict2;
-    dict2.readCompressed(bin);
+  } catch (const char *msg) {
+    cerr << msg << '\n';
+    return 1;
   }
-#endif
 }
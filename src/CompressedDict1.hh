@@ -0,0 +1,440 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "Alphabet.hh"
+#include "Bitstream.hh"
+#include "DictFile.hh"
+#include "PackedSymbols.hh"
+#include "Tokenizer.hh"
+
+/*
+  The alphabet and the bits in the count of a bucket are template
+  parameters. Base, END and the symbols per 64-bit word follow from the
+  alphabet size. The input must be sorted in code order.
+
+  Every prefix of the words is either a trie node, split by the symbol
+  after it, or a bucket holding its words packed without the prefix. The
+  words are counted under every prefix in one pass, then plan() decides
+  for each prefix, bottom up, whichever of the two is cheaper in bytes
+  plus workWeight times the symbols a lookup has to decode. The nodes go
+  in the header in preorder, the root first:
+
+    trie node   1, isWord, a bit per symbol with a child, then the children
+    bucket      0, isWord, the number of words in hashSizeBits bits (the
+                prefix itself counts as an empty word)
+
+  and the words of the buckets follow one another in the packed words.
+*/
+template <typename Alphabet = Alpha26, uint32_t hashSizeBits = 7>
+class CompressedDict1 {
+ public:
+  // what plan() chose, and what the cost model predicts for it
+  struct Plan {
+    uint32_t trieNodes, buckets, largestBucket;
+    uint64_t headerBits;
+    double wordBits;
+    double work;  // trie nodes and symbols read per lookup of a word
+    double bytes() const { return (headerBits + wordBits) / 8; }
+  };
+
+ private:
+  using Packing = SymbolPacking<Alphabet::size>;
+  static constexpr uint32_t S = Alphabet::size;
+  static_assert(S <= 61, "a trie node holds a bit per symbol in 64 bits");
+  static constexpr uint32_t maxBucket = (1 << hashSizeBits) - 1;
+  static constexpr double symbolBits = 64.0 / Packing::perWord;
+  static constexpr uint8_t END = Packing::END;
+
+  struct Prefix {
+    uint32_t first;    // the first word with this prefix
+    uint32_t count;    // words with this prefix, the prefix itself included
+    uint32_t child;    // the first prefix one symbol longer, 0 if none
+    uint32_t sibling;  // the next prefix with the same parent, 0 if none
+    uint16_t len;
+    uint8_t code;  // the last symbol
+    bool isWord;
+    bool split;   // chosen by plan(): a trie node, not a bucket
+    double bits;  // of the subtree as planned
+    double work;  // of looking up every word of the subtree once
+  };
+
+  Alphabet alphabet;
+  std::vector<char> dict;
+  using Span = Tokenizer<NON_SPACE>::Span;
+  std::vector<Span> words;       // every word of dict in order, found once
+  std::vector<Prefix> prefixes;  // in preorder, prefixes[0] is the empty one
+  // symbols[i] = sum over words before i of len+1
+  std::vector<uint64_t> symbols;
+  std::vector<uint64_t> weighted;  // the same with each term times its index
+  std::vector<uint64_t> header;
+  std::vector<uint64_t> compressedWords;
+  SymbolPacker<S> packer;
+  uint64_t headerBits;
+
+  inline void writeOneChar(uint8_t code) { packer.put(code); }
+  bool isSymbol(char c) const { return alphabet.index(c) >= 0; }
+
+  // letter k of word w, or 0 past the end of the word
+  char letter(uint32_t w, uint32_t k) const {
+    return k < words[w].len ? dict[words[w].start + k] : 0;
+  }
+
+  void writeOneWord(uint32_t &w, uint32_t prefixLen) {
+    // write each letter of the word in base 27 or 28, 13 characters per 64
+    // bit word
+    for (uint32_t k = prefixLen; k < words[w].len; k++)
+      writeOneChar(alphabet.index(letter(w, k)));
+    writeOneChar(END);  // end the word with a special token
+    w++;
+  }
+
+  /*
+    One pass over the sorted words makes a Prefix of every prefix of every
+    word with the number of words under it. The prefixes of the current
+    word are kept on a stack; a word pops those it does not share with the
+    word before and pushes the rest.
+  */
+  void countPrefixes() {
+    prefixes.assign(1, Prefix());
+    std::vector<uint32_t> path(1, 0);
+    std::vector<uint32_t> lastChild(1, 0);
+    symbols.assign(words.size() + 1, 0);
+    weighted.assign(words.size() + 1, 0);
+    for (uint32_t w = 0; w < words.size(); w++) {
+      uint32_t len = words[w].len, common = 0;
+      while (common + 1 < path.size() && common < len &&
+             letter(w, common) == letter(w - 1, common))
+        common++;
+      path.resize(common + 1);
+      lastChild.resize(common + 1);
+      for (uint32_t k = common; k < len; k++) {
+        uint8_t code = alphabet.index(letter(w, k));
+        uint32_t at = prefixes.size(), parent = path.back();
+        if (lastChild.back() == 0)
+          prefixes[parent].child = at;
+        else if (prefixes[lastChild.back()].code < code)
+          prefixes[lastChild.back()].sibling = at;
+        else
+          throw "words must be sorted in code order, without repeats";
+        lastChild.back() = at;
+        Prefix p = {};
+        p.first = w;
+        p.len = k + 1;
+        p.code = code;
+        prefixes.push_back(p);
+        path.push_back(at);
+        lastChild.push_back(0);
+      }
+      if (common == len && w != 0)  // a word that is a prefix of the last
+        throw "words must be sorted in code order, without repeats";
+      for (uint32_t at : path) prefixes[at].count++;
+      prefixes[path.back()].isWord = true;
+      symbols[w + 1] = symbols[w] + len + 1;
+      weighted[w + 1] = weighted[w] + uint64_t(w) * (len + 1);
+    }
+  }
+
+  // the bits and work of a prefix as one bucket of its words
+  double bucketBits(const Prefix &p) const {
+    uint32_t f = p.first, c = p.count;
+    uint64_t syms = symbols[f + c] - symbols[f] - uint64_t(p.len) * c;
+    return hashSizeBits + 2 + syms * symbolBits;
+  }
+  /*
+    Finding word j of a bucket decodes words 0..j, so every word of the
+    bucket costs its own symbols once for each word from it to the end.
+  */
+  double bucketWork(const Prefix &p) const {
+    uint64_t f = p.first, c = p.count, end = f + c;
+    double syms = double(end) * (symbols[end] - symbols[f]) -
+                  double(weighted[end] - weighted[f]) -
+                  double(p.len) * c * (c + 1) / 2;
+    return c + syms;  // and each reads the bucket's node
+  }
+
+  void writeNode(uint32_t at, Bitstream &bits) {
+    const Prefix &p = prefixes[at];
+    if (p.split) {
+      uint64_t children = 0;
+      for (uint32_t c = p.child; c != 0; c = prefixes[c].sibling)
+        children |= 1ULL << prefixes[c].code;
+      bits.write(1 | uint64_t(p.isWord) << 1 | children << 2, S + 2);
+      for (uint32_t c = p.child; c != 0; c = prefixes[c].sibling)
+        writeNode(c, bits);
+    } else {
+      bits.write(uint64_t(p.isWord) << 1 | uint64_t(p.count) << 2,
+                 hashSizeBits + 2);
+      for (uint32_t w = p.first; w < p.first + p.count;)
+        writeOneWord(w, p.len);
+    }
+  }
+
+ public:
+  CompressedDict1(const char filename[])
+      : packer(compressedWords), headerBits(0) {
+    {
+      std::ifstream f(filename);
+      f.seekg(0, std::ios::end);  // go to the end
+      dict.resize(f.tellg());
+      f.seekg(0, std::ios::beg);  // go back to the beginning
+      f.read(dict.data(), dict.size());  // read the whole file into the buffer
+      if constexpr (Alphabet::remaps) alphabet.build(dict.data(), dict.size());
+      Tokenizer<NON_SPACE> tok(dict.data(), dict.size());
+      uint32_t skipped = 0;
+      for (Span w; tok.next(w);) {
+        bool ok = w.len < 65536;
+        for (uint32_t k = 0; ok && k < w.len; k++)
+          ok = isSymbol(dict[w.start + k]);
+        if (ok)
+          words.push_back(w);
+        else
+          skipped++;
+      }
+      if (skipped != 0)
+        std::cerr << "skipped " << skipped
+                  << " words not within the alphabet\n";
+    }
+    countPrefixes();
+  }
+
+  uint32_t numWords() const { return words.size(); }
+  uint32_t numPrefixes() const { return prefixes.size() - 1; }
+
+  /*
+    Choose a trie node or a bucket for every prefix. With adaptive, each
+    subtree takes whichever costs least in bytes + workWeight * (symbols
+    decoded per lookup), children first so each choice is exact for its
+    subtree. Otherwise every prefix with more words than a bucket holds is
+    split and no other, the fixed threshold of the recursive builder.
+  */
+  Plan plan(double workWeight, bool adaptive = true) {
+    double perLookup = workWeight / std::max<size_t>(words.size(), 1);
+    for (uint32_t at = prefixes.size(); at-- > 0;) {
+      Prefix &p = prefixes[at];
+      bool canBucket = at != 0 && p.count <= maxBucket;
+      double splitBits = S + 2, splitWork = p.count;
+      for (uint32_t c = p.child; c != 0; c = prefixes[c].sibling) {
+        splitBits += prefixes[c].bits;
+        splitWork += prefixes[c].work;
+      }
+      if (canBucket) {
+        double bits = bucketBits(p), work = bucketWork(p);
+        p.split = p.child != 0 &&
+                  (adaptive ? splitBits / 8 + perLookup * splitWork <
+                                  bits / 8 + perLookup * work
+                            : false);
+        if (!p.split) {
+          p.bits = bits;
+          p.work = work;
+          continue;
+        }
+      }
+      if (p.child == 0 && at != 0) throw "prefix too big for a bucket";
+      p.split = true;
+      p.bits = splitBits;
+      p.work = splitWork;
+    }
+
+    Plan r = {};
+    for (std::vector<uint32_t> todo(1, 0); !todo.empty();) {
+      const Prefix &p = prefixes[todo.back()];
+      todo.pop_back();
+      if (p.split) {
+        r.trieNodes++;
+        r.headerBits += S + 2;
+        for (uint32_t c = p.child; c != 0; c = prefixes[c].sibling)
+          todo.push_back(c);
+      } else {
+        r.buckets++;
+        r.headerBits += hashSizeBits + 2;
+        r.wordBits += p.bits - (hashSizeBits + 2);
+        r.largestBucket = std::max(r.largestBucket, p.count);
+      }
+    }
+    r.work = prefixes[0].work / std::max<size_t>(words.size(), 1);
+    headerBits = r.headerBits;
+    return r;
+  }
+
+  // the header and packed words of the last plan
+  void build() {
+    if (headerBits == 0) throw "plan the layout first";
+    header.assign(headerBits / 64 + 2, 0);
+    compressedWords.clear();
+    compressedWords.reserve(symbols.back() / Packing::perWord + 2);
+    Bitstream bits(header.data());
+    writeNode(0, bits);
+    packer.flush();
+    header.resize((headerBits + 63) / 64);
+  }
+
+  void displayCompressedWord(uint64_t w) {
+    uint8_t digits[Packing::perWord];
+    Packing::unpack(w, digits);
+    for (uint32_t i = 0; i < Packing::perWord; i++) {
+      uint8_t c = digits[i];
+      std::cout << (c < END ? (char)alphabet.symbol(c) : ' ');
+    }
+    std::cout << std::flush;
+  }
+
+  static constexpr uint64_t layout() {
+    return uint64_t(Alphabet::size) | uint64_t(hashSizeBits) << 8 | 1ULL << 16;
+  }
+  /*
+    The trie and the words as sections of a DictFile. words.bin is the raw
+    packed words alone, which readCompressedDict prints.
+  */
+  void writeCompressed(const char filename[]) {
+    build();
+    DictFileWriter w(DICT_COMPRESSED_TRIE, layout());
+    if (alphabet.headerSize() != 0)
+      w.add(SECTION_ALPHABET, alphabet.header(), alphabet.headerSize());
+    w.add(SECTION_COMPRESSED_HEADER, header.data(),
+          header.size() * sizeof(uint64_t));
+    w.add(SECTION_COMPRESSED_WORDS, compressedWords.data(),
+          compressedWords.size() * sizeof(uint64_t));
+    w.write(filename);
+#if 0
+    for (uint32_t i = 0; i < compressedWords.size(); i++)
+      displayCompressedWord(compressedWords[i]);
+#endif
+    std::ofstream bin2("words.bin", std::ios::binary);
+    bin2.write((char *)&compressedWords[0],
+               compressedWords.size() * sizeof(uint64_t));
+  }
+};
+
+/*
+  Read a file written by CompressedDict1. The header is walked once into
+  an array of nodes, the children of each node side by side so a lookup
+  steps down by the rank of its next symbol, and each bucket remembers
+  where its words start. A lookup then decodes its bucket up to the word.
+*/
+template <typename Alphabet = Alpha26, uint32_t hashSizeBits = 7>
+class CompressedDict1Reader {
+ private:
+  using Packing = SymbolPacking<Alphabet::size>;
+  static constexpr uint32_t S = Alphabet::size;
+
+  struct Node {
+    uint64_t children;  // a bit per symbol, 0 for a bucket
+    uint64_t start;     // of a bucket, its first symbol in the packed words
+    uint32_t child;     // index of the first child
+    uint32_t count;     // words in a bucket
+    bool bucket, isWord;
+  };
+
+  DictFileReader file;
+  Alphabet alphabet;
+  const uint64_t *header;
+  uint64_t headerBits;
+  const uint64_t *words;
+  uint64_t numSymbols;
+  std::vector<Node> nodes;
+
+  uint64_t readBits(uint64_t &bit, uint32_t len) const {
+    if (bit + len > headerBits) throw "Dictionary file is corrupt";
+    uint64_t v = header[bit / 64] >> bit % 64;
+    if (bit % 64 + len > 64) v |= header[bit / 64 + 1] << (64 - bit % 64);
+    bit += len;
+    return v & (~0ULL >> (64 - len));
+  }
+  uint8_t symbolAt(uint64_t pos) const {
+    if (pos >= numSymbols) throw "Dictionary file is corrupt";
+    uint8_t digits[Packing::perWord];
+    Packing::unpack(words[pos / Packing::perWord], digits);
+    return digits[pos % Packing::perWord];
+  }
+
+  void parse(uint32_t at, uint64_t &bit, uint64_t &pos) {
+    bool trie = readBits(bit, 1);
+    nodes[at].isWord = readBits(bit, 1);
+    if (trie) {
+      uint64_t children = readBits(bit, S);
+      uint32_t child = nodes.size(), n = __builtin_popcountll(children);
+      nodes[at].children = children;
+      nodes[at].child = child;
+      nodes.resize(child + n);
+      for (uint32_t i = 0; i < n; i++) parse(child + i, bit, pos);
+    } else {
+      uint32_t count = readBits(bit, hashSizeBits);
+      nodes[at].bucket = true;
+      nodes[at].count = count;
+      nodes[at].start = pos;
+      for (uint32_t w = 0; w < count; pos++)
+        w += symbolAt(pos) == Packing::END;
+    }
+  }
+
+ public:
+  CompressedDict1Reader(const char filename[]) {
+    using Writer = CompressedDict1<Alphabet, hashSizeBits>;
+    file.open(filename, DICT_COMPRESSED_TRIE, Writer::layout());
+    uint64_t len;
+    if (alphabet.headerSize() != 0) {
+      const char *p = file.section(SECTION_ALPHABET, len);
+      if (len != alphabet.headerSize()) throw "Dictionary file is corrupt";
+      alphabet.read(p);
+    }
+    header = (const uint64_t *)file.section(SECTION_COMPRESSED_HEADER, len);
+    headerBits = len / sizeof(uint64_t) * 64;
+    words = (const uint64_t *)file.section(SECTION_COMPRESSED_WORDS, len);
+    numSymbols = len / sizeof(uint64_t) * Packing::perWord;
+    uint64_t bit = 0, pos = 0;
+    nodes.resize(1);
+    parse(0, bit, pos);
+  }
+
+  uint64_t headerBytes() const { return (headerBits + 7) / 8; }
+  uint64_t wordBytes() const {
+    return numSymbols / Packing::perWord * sizeof(uint64_t);
+  }
+
+  /*
+    Look a word up, adding the trie nodes and symbols read to work, the
+    same count the cost model predicts.
+  */
+  bool get(const char word[], uint32_t len, uint64_t &work) const {
+    const Node *n = &nodes[0];
+    uint32_t k = 0;
+    for (; !n->bucket; k++) {
+      work++;
+      if (k == len) return n->isWord;
+      int32_t c = alphabet.index(word[k]);
+      if (c < 0 || (n->children >> c & 1) == 0) return false;
+      n = &nodes[n->child +
+                 __builtin_popcountll(n->children & ((1ULL << c) - 1))];
+    }
+    work++;
+    uint8_t digits[Packing::perWord];
+    uint64_t pos = n->start;
+    Packing::unpack(words[pos / Packing::perWord], digits);
+    for (uint32_t w = 0; w < n->count; w++) {
+      // the bucket is sorted: stop at the first word past the target
+      int32_t order = 0;
+      for (uint32_t at = k;; at++, pos++) {
+        if (pos % Packing::perWord == 0)
+          Packing::unpack(words[pos / Packing::perWord], digits);
+        uint8_t d = digits[pos % Packing::perWord];
+        work++;
+        if (d == Packing::END) {
+          if (order == 0 && at == len) return true;
+          pos++;
+          break;
+        }
+        if (order == 0) {
+          int32_t c = at < len ? alphabet.index(word[at]) : -1;
+          if (c != d) order = c < int32_t(d) ? 1 : -1;
+        }
+        if (order > 0) return false;
+      }
+    }
+    return false;
+  }
+};
@@ -0,0 +1,205 @@
+#pragma once
+
+/*
+  Lookups as C++20 coroutines, so code that looks words up one at a time
+  still overlaps their cache misses. A lookup prefetches the line it is
+  about to read and suspends; the scheduler resumes the next lookup that
+  is ready, and by the time the first comes round again its line has
+  arrived. With a few dozen lookups in flight per thread, this is the
+  group prefetching of getBatch without gathering the words into batches:
+
+    CoroTask<uint64_t> handler(const TrieHashDict &dict, ...) {
+      uint64_t sum = 0;
+      for (...) sum += co_await dict.getAsync(word, len);  // id, or 0
+      co_return sum;
+    }
+    CoroScheduler s;
+    for (uint32_t i = 0; i < 32; i++) s.spawn(handler(dict, ...));
+    s.run();
+
+  Everything runs on the thread calling run(); use one scheduler per
+  thread. A task starts when it is awaited or spawned, an awaited one
+  resumes its caller when it returns, and a spawned one is freed by the
+  scheduler when it is done. Frames are recycled per thread, so a lookup
+  does not go to malloc. Only compiled as C++20 (TRIEHASH_COROUTINES is
+  defined then); as C++17 this header is empty.
+*/
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define TRIEHASH_COROUTINES 1
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <utility>
+#include <vector>
+
+class CoroScheduler;
+
+// recycled coroutine frames of up to SIZE bytes, one free list per thread
+class CoroFrames {
+ private:
+  static constexpr size_t SIZE = 1024;
+  struct Free {
+    Free *next;
+  };
+  static Free *&head() {
+    thread_local Free *h = nullptr;
+    return h;
+  }
+
+ public:
+  static void *allocate(size_t n) {
+    Free *f = head();
+    if (n > SIZE || f == nullptr) return ::operator new(n > SIZE ? n : SIZE);
+    head() = f->next;
+    return f;
+  }
+  static void release(void *p, size_t n) {
+    if (n > SIZE) {
+      ::operator delete(p);
+      return;
+    }
+    Free *f = (Free *)p;
+    f->next = head();
+    head() = f;
+  }
+};
+
+// what every task's promise has, so an awaitable can reach the scheduler
+struct CoroPromiseBase {
+  CoroScheduler *scheduler = nullptr;
+  std::coroutine_handle<> continuation;  // the caller awaiting this task
+  bool detached = false;                 // spawned, freed when done
+  std::exception_ptr error;
+
+  static void *operator new(size_t n) { return CoroFrames::allocate(n); }
+  static void operator delete(void *p, size_t n) {
+    CoroFrames::release(p, n);
+  }
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  void unhandled_exception() { error = std::current_exception(); }
+};
+
+template <typename T>
+struct CoroValue : CoroPromiseBase {
+  T value{};
+  void return_value(T v) { value = std::move(v); }
+  T get() { return std::move(value); }
+};
+template <>
+struct CoroValue<void> : CoroPromiseBase {
+  void return_void() {}
+  void get() {}
+};
+
+/*
+  Run tasks on one thread, resuming them in the order they became ready.
+  spawn() hands a task over and run() returns when every task is done,
+  rethrowing the first error of a spawned task.
+*/
+class CoroScheduler {
+ private:
+  // a ring of the tasks ready to resume, its size a power of 2
+  std::vector<std::coroutine_handle<>> ready;
+  uint32_t head = 0, tail = 0;  // count up, masked on use
+  std::exception_ptr error;
+
+  void grow() {
+    std::vector<std::coroutine_handle<>> bigger(ready.size() * 2);
+    for (uint32_t i = head; i != tail; i++)
+      bigger[i - head] = ready[i & (ready.size() - 1)];
+    tail -= head;
+    head = 0;
+    ready.swap(bigger);
+  }
+
+ public:
+  CoroScheduler() : ready(64) {}
+  void post(std::coroutine_handle<> h) {
+    if (tail - head == ready.size()) grow();
+    ready[tail++ & (ready.size() - 1)] = h;
+  }
+  void fail(std::exception_ptr e) {
+    if (!error) error = e;
+  }
+  template <typename Task>
+  void spawn(Task &&task) {
+    auto h = task.release();
+    h.promise().scheduler = this;
+    h.promise().detached = true;
+    post(h);
+  }
+  void run() {
+    while (head != tail) ready[head++ & (ready.size() - 1)].resume();
+    if (error) std::rethrow_exception(std::exchange(error, nullptr));
+  }
+};
+
+template <typename T = void>
+class CoroTask {
+ public:
+  struct promise_type : CoroValue<T> {
+    CoroTask get_return_object() {
+      return CoroTask(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    struct Final {
+      bool await_ready() noexcept { return false; }
+      std::coroutine_handle<> await_suspend(
+          std::coroutine_handle<promise_type> h) noexcept {
+        promise_type &p = h.promise();
+        if (p.continuation) return p.continuation;
+        if (p.detached) {
+          if (p.error) p.scheduler->fail(p.error);
+          h.destroy();
+        }
+        return std::noop_coroutine();
+      }
+      void await_resume() noexcept {}
+    };
+    Final final_suspend() noexcept { return {}; }
+  };
+
+ private:
+  std::coroutine_handle<promise_type> h;
+
+ public:
+  explicit CoroTask(std::coroutine_handle<promise_type> h) : h(h) {}
+  CoroTask(CoroTask &&t) : h(std::exchange(t.h, nullptr)) {}
+  CoroTask(const CoroTask &) = delete;
+  ~CoroTask() {
+    if (h) h.destroy();
+  }
+  std::coroutine_handle<promise_type> release() {
+    return std::exchange(h, nullptr);
+  }
+
+  // awaited by another task: run on its scheduler, then resume it
+  bool await_ready() const noexcept { return false; }
+  template <typename P>
+  std::coroutine_handle<> await_suspend(
+      std::coroutine_handle<P> caller) noexcept {
+    h.promise().scheduler = caller.promise().scheduler;
+    h.promise().continuation = caller;
+    return h;
+  }
+  T await_resume() {
+    if (h.promise().error) std::rethrow_exception(h.promise().error);
+    return h.promise().get();
+  }
+};
+
+// prefetch p, and let the other tasks run while the line comes in
+struct CoroPrefetch {
+  const void *p;
+  bool await_ready() const noexcept { return false; }
+  template <typename P>
+  void await_suspend(std::coroutine_handle<P> h) const noexcept {
+    __builtin_prefetch(p);
+    h.promise().scheduler->post(h);
+  }
+  void await_resume() const noexcept {}
+};
+
+#endif
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "DictStats.hh"
+#include "LookupCache.hh"
+#include "Tokenizer.hh"
+
+/*
+  Turn a large text into a stream of word ids, on all cores.
+
+  The text is cut into chunks of about chunkBytes, each boundary moved
+  forward so no word is split. Every thread starts with an equal run of
+  chunks and takes them from the front; a thread that runs out steals the
+  back half of the run of whichever thread has the most left, so a slow
+  chunk or a slow core does not hold up the rest. A run is a begin and end
+  index packed in one atomic word, so taking and stealing are each a single
+  compare and swap.
+
+  Each chunk is split by a Tokenizer<LETTERS>, which lowers the letters as
+  it finds the words: a word is a run of the letters a-z in either case,
+  anything else separates words. The lowered words of a chunk then go to
+  the dictionary's getBatch together, so their cache misses overlap.
+
+  With cacheEntries, every thread puts a LookupCache of that many entries
+  in front of the dictionary, so the words a text keeps repeating are
+  answered from the cache and only the rest go to getBatch.
+
+  The ids of a chunk are handed to the sink in text order: whichever thread
+  finishes the chunk that is next in line passes on it and every finished
+  chunk after it. A word that is not in the dictionary gets id 0.
+*/
+template <typename Dict>
+class CorpusPipeline {
+ public:
+  struct Result {
+    uint64_t bytes;
+    uint64_t words;
+    uint64_t found;
+    uint32_t steals;  // runs of chunks taken from another thread
+    double seconds;
+    LookupStats stats;  // the cache hits and misses of all the threads
+  };
+
+ private:
+  struct Chunk {
+    std::vector<uint32_t> ids;
+    uint64_t words;
+    uint64_t found;
+    bool done;
+  };
+  // what one thread needs to scan and look up a chunk, reused between chunks
+  struct Scratch {
+    std::vector<char> lowered;
+    std::vector<const char *> words;
+    std::vector<uint32_t> lens;
+    std::unique_ptr<LookupCache<Dict>> cache;
+  };
+
+  const Dict &dict;
+  uint32_t numThreads;
+  uint32_t chunkBytes;
+  uint32_t cacheEntries;
+
+  static uint64_t pack(uint32_t begin, uint32_t end) {
+    return uint64_t(begin) << 32 | end;
+  }
+  static bool isLetter(char c) { return uint8_t((c | 0x20) - 'a') < 26; }
+
+  // the start of every chunk, and the end of the text last
+  std::vector<uint64_t> boundaries(const char text[], uint64_t len) const {
+    std::vector<uint64_t> b{0};
+    for (uint64_t at = chunkBytes; at < len; at += chunkBytes) {
+      while (at < len && isLetter(text[at]) && isLetter(text[at - 1])) at++;
+      if (at > b.back() && at < len) b.push_back(at);
+    }
+    b.push_back(len);
+    return b;
+  }
+
+  // lower the letters of text into s.lowered and record the words
+  static void scan(const char text[], uint64_t len, Scratch &s) {
+    s.lowered.resize(len);
+    s.words.clear();
+    s.lens.clear();
+    Tokenizer<LETTERS> tok(text, len, s.lowered.data());
+    for (Tokenizer<LETTERS>::Span w; tok.next(w);) {
+      s.words.push_back(s.lowered.data() + w.start);
+      s.lens.push_back(w.len);
+    }
+  }
+
+  void process(const char text[], uint64_t len, Scratch &s, Chunk &c) const {
+    scan(text, len, s);
+    c.words = s.words.size();
+    c.ids.resize(c.words);
+    c.found = s.cache != nullptr
+                  ? s.cache->getBatch(s.words.data(), s.lens.data(),
+                                      s.words.size(), c.ids.data())
+                  : dict.getBatch(s.words.data(), s.lens.data(),
+                                  s.words.size(), c.ids.data());
+  }
+
+ public:
+  CorpusPipeline(const Dict &dict, uint32_t threads = 0,
+                 uint32_t chunkBytes = 1 << 20, uint32_t cacheEntries = 0)
+      : dict(dict),
+        numThreads(threads != 0
+                       ? threads
+                       : std::max(1U, std::thread::hardware_concurrency())),
+        chunkBytes(chunkBytes),
+        cacheEntries(cacheEntries) {
+    if ((cacheEntries & (cacheEntries - 1)) != 0)
+      throw "cache size must be a power of 2";
+  }
+
+  /*
+    Look up every word of text, calling out(const uint32_t ids[], uint64_t n)
+    with the ids in text order. out is called by one thread at a time.
+  */
+  template <typename Sink>
+  Result run(const char text[], uint64_t len, Sink out) const {
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<uint64_t> b = boundaries(text, len);
+    uint32_t numChunks = b.size() - 1;
+    std::vector<Chunk> chunks(numChunks);
+    for (Chunk &c : chunks) c.done = false;
+    uint32_t threads = std::min(numThreads, std::max(numChunks, 1U));
+    std::unique_ptr<std::atomic<uint64_t>[]> runs(
+        new std::atomic<uint64_t>[threads]);
+    for (uint32_t t = 0; t < threads; t++)
+      runs[t] = pack(uint64_t(numChunks) * t / threads,
+                     uint64_t(numChunks) * (t + 1) / threads);
+    std::mutex outLock;
+    uint32_t nextOut = 0;
+    std::atomic<uint32_t> steals(0);
+    LookupStats stats;
+
+    // the next chunk of thread t, stealing if its own run is empty
+    auto take = [&](uint32_t t) -> int64_t {
+      for (;;) {
+        uint64_t r = runs[t].load();
+        while (uint32_t(r >> 32) < uint32_t(r))
+          if (runs[t].compare_exchange_weak(r, r + (1ULL << 32)))
+            return r >> 32;
+        uint32_t victim = t, most = 0;
+        for (uint32_t v = 0; v < threads; v++) {
+          uint64_t vr = runs[v].load();
+          uint32_t left =
+              uint32_t(vr) - std::min(uint32_t(vr), uint32_t(vr >> 32));
+          if (left > most) most = left, victim = v;
+        }
+        if (most == 0) return -1;
+        uint64_t vr = runs[victim].load();
+        uint32_t begin = vr >> 32, end = vr;
+        if (begin >= end) continue;
+        uint32_t mid = end - (end - begin + 1) / 2;  // the thief gets the back
+        if (runs[victim].compare_exchange_strong(vr, pack(begin, mid))) {
+          runs[t] = pack(mid, end);
+          steals++;
+        }
+      }
+    };
+    auto worker = [&](uint32_t t) {
+      Scratch s;
+      if (cacheEntries != 0)
+        s.cache.reset(new LookupCache<Dict>(dict, cacheEntries));
+      for (int64_t i; (i = take(t)) >= 0;) {
+        process(text + b[i], b[i + 1] - b[i], s, chunks[i]);
+        std::lock_guard<std::mutex> lock(outLock);
+        chunks[i].done = true;
+        for (; nextOut < numChunks && chunks[nextOut].done; nextOut++) {
+          out((const uint32_t *)chunks[nextOut].ids.data(),
+              uint64_t(chunks[nextOut].ids.size()));
+          std::vector<uint32_t>().swap(chunks[nextOut].ids);
+        }
+      }
+      if (s.cache != nullptr) {
+        std::lock_guard<std::mutex> lock(outLock);
+        stats += s.cache->getStats();
+      }
+    };
+    std::vector<std::thread> pool;
+    for (uint32_t t = 1; t < threads; t++) pool.emplace_back(worker, t);
+    worker(0);
+    for (std::thread &th : pool) th.join();
+
+    Result r = {len, 0, 0, steals, 0, stats};
+    for (const Chunk &c : chunks) {
+      r.words += c.words;
+      r.found += c.found;
+    }
+    r.seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - t0)
+                    .count();
+    return r;
+  }
+
+  // run over a file, mapped rather than read
+  template <typename Sink>
+  Result runFile(const char filename[], Sink out) const {
+    int fh = ::open(filename, O_RDONLY);
+    if (fh < 0) throw "Could not open corpus";
+    struct stat st;
+    fstat(fh, &st);
+    uint64_t len = st.st_size;
+    void *p = len == 0 ? nullptr
+                       : mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fh, 0);
+    ::close(fh);
+    if (p == MAP_FAILED) throw "Could not map corpus";
+    if (p != nullptr) madvise(p, len, MADV_SEQUENTIAL);
+    Result r;
+    try {
+      r = run((const char *)p, len, out);
+    } catch (...) {
+      if (p != nullptr) munmap(p, len);
+      throw;
+    }
+    if (p != nullptr) munmap(p, len);
+    return r;
+  }
+};
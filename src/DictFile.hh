@@ -0,0 +1,362 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+/*
+  The file format shared by every saved dictionary.
+
+    FileHeader      64 bytes: magic, version, byte order, what kind of
+                    dictionary and with which compile-time layout
+    section table   numSections SectionEntry of 32 bytes
+    sections        each starting on an alignment boundary (4096 by default)
+
+  Every section is aligned, so an mmap of the file can be used in place, one
+  section can be mapped or read on its own, and the structs inside are
+  naturally aligned. The data is the in-memory representation of the
+  machine that wrote it. The byte order mark rejects a file from a machine
+  of the other endianness rather than misreading it, and the layout word
+  rejects a file written by a differently instantiated template.
+
+  Each section carries a CRC32C. Opening a file only checks the header and
+  that every section lies inside the file, which costs nothing per byte.
+  verify() computes a section's checksum the first time it is asked for,
+  so a service can start serving at once and check in the background, or
+  only check the sections it actually touches.
+*/
+
+enum DictKind : uint32_t {
+  DICT_TRIEHASH = 1,         // TrieDict.hh
+  DICT_COMPRESSED3 = 2,      // Compressed3letterTrie.cc
+  DICT_COMPRESSED_TRIE = 3,  // CompressedDict1.hh
+};
+
+enum SectionId : uint32_t {
+  SECTION_INFO = 1,
+  SECTION_ALPHABET = 2,
+  SECTION_TEXT = 3,
+  SECTION_DIRECTORY = 4,
+  SECTION_HASHMAPS = 5,
+  SECTION_NODES = 6,
+  SECTION_HOT = 7,                 // optional, the hot word table
+  SECTION_SHORT = 8,               // optional, words shorter than the prefix
+  SECTION_RANK = 9,                // text offsets of every 8th id
+  SECTION_FILTER = 10,             // optional, a blocked Bloom filter
+  SECTION_MEMBERS = 11,            // MultiDict, which dictionaries have an id
+  SECTION_NAMES = 12,              // MultiDict, the dictionary names
+  SECTION_COMPRESSED_HEADER = 16,  // bin counts or trie nodes
+  SECTION_COMPRESSED_WORDS = 17,   // packed base (alphabet+1) blocks
+};
+
+class Crc32c {
+ private:
+  static const uint32_t *table() {
+    // built once, by whichever thread gets here first
+    static const std::array<uint32_t, 256> t = [] {
+      std::array<uint32_t, 256> t;
+      for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c >> 1) ^ (0x82F63B78 & (0 - (c & 1)));
+        t[i] = c;
+      }
+      return t;
+    }();
+    return t.data();
+  }
+
+ public:
+  // CRC32C (Castagnoli), with the SSE4.2 instruction when compiled for it
+  static uint32_t compute(const void *data, uint64_t len, uint32_t crc = 0) {
+    const uint8_t *p = (const uint8_t *)data;
+    crc = ~crc;
+#ifdef __SSE4_2__
+    for (; len >= 8; len -= 8, p += 8) {
+      uint64_t v;
+      memcpy(&v, p, 8);
+      crc = _mm_crc32_u64(crc, v);
+    }
+    for (; len > 0; len--) crc = _mm_crc32_u8(crc, *p++);
+#else
+    const uint32_t *t = table();
+    for (; len > 0; len--) crc = t[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+#endif
+    return ~crc;
+  }
+};
+
+class DictFile {
+ public:
+  static constexpr char MAGIC[8] = {'T', 'R', 'I', 'E', 'H', 'A', 'S', 'H'};
+  static constexpr uint32_t VERSION = 1;
+  static constexpr uint64_t BYTE_ORDER_MARK = 0x0102030405060708ULL;
+
+  struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;         // DictKind
+    uint64_t byteOrder;    // BYTE_ORDER_MARK as written
+    uint64_t layout;       // template parameters of the writer, see layout()
+    uint64_t fileSize;
+    uint32_t numSections;
+    uint32_t alignment;    // every section offset is a multiple of this
+    uint32_t headerCrc;    // CRC32C of this header (with this field 0) and
+                           // the section table
+    uint32_t unused[3];
+  };
+  struct SectionEntry {
+    uint32_t id;  // SectionId
+    uint32_t crc;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t unused;
+  };
+  static_assert(sizeof(FileHeader) == 64 && sizeof(SectionEntry) == 32,
+                "the header is part of the file format");
+
+  // read the header of a file, false if it is not a dictionary file
+  static bool readHeader(const char filename[], FileHeader &h) {
+    int fh = ::open(filename, O_RDONLY);
+    if (fh < 0) throw "Could not open dictionary file";
+    ssize_t n = ::read(fh, &h, sizeof(h));
+    ::close(fh);
+    return n == sizeof(h) && memcmp(h.magic, MAGIC, sizeof(MAGIC)) == 0;
+  }
+  // the DictKind of a file, or 0 if it is not a dictionary file
+  static uint32_t kindOf(const char filename[]) {
+    FileHeader h;
+    return readHeader(filename, h) ? h.kind : 0;
+  }
+};
+
+class DictFileWriter : public DictFile {
+ private:
+  struct Pending {
+    uint32_t id;
+    const void *data;
+    uint64_t size;
+  };
+  uint32_t kind;
+  uint64_t layout;
+  uint32_t alignment;
+  std::vector<Pending> sections;
+
+  static bool writeAll(int fh, const void *data, uint64_t len) {
+    const char *p = (const char *)data;
+    while (len > 0) {
+      ssize_t n = ::write(fh, p, len);
+      if (n <= 0) return false;
+      p += n;
+      len -= n;
+    }
+    return true;
+  }
+
+ public:
+  DictFileWriter(uint32_t kind, uint64_t layout, uint32_t alignment = 4096)
+      : kind(kind), layout(layout), alignment(alignment) {}
+
+  // the data must stay valid until write()
+  void add(uint32_t id, const void *data, uint64_t size) {
+    sections.push_back({id, data, size});
+  }
+
+  /*
+    Write to filename.tmp and rename, so a reader never sees a half written
+    dictionary and a failed save leaves the old file alone.
+  */
+  void write(const char filename[]) const {
+    FileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.kind = kind;
+    h.byteOrder = BYTE_ORDER_MARK;
+    h.layout = layout;
+    h.numSections = sections.size();
+    h.alignment = alignment;
+    std::vector<SectionEntry> table(sections.size());
+    uint64_t offset = sizeof(FileHeader) + table.size() * sizeof(SectionEntry);
+    for (uint32_t i = 0; i < sections.size(); i++) {
+      offset = (offset + alignment - 1) / alignment * alignment;
+      table[i] = {sections[i].id,
+                  Crc32c::compute(sections[i].data, sections[i].size), offset,
+                  sections[i].size, 0};
+      offset += sections[i].size;
+    }
+    h.fileSize = offset;
+    h.headerCrc = Crc32c::compute(
+        table.data(), table.size() * sizeof(SectionEntry),
+        Crc32c::compute(&h, sizeof(h)));
+
+    std::string tmp = std::string(filename) + ".tmp";
+    int fh = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fh < 0) throw "Could not create dictionary file";
+    bool ok = writeAll(fh, &h, sizeof(h)) &&
+              writeAll(fh, table.data(), table.size() * sizeof(SectionEntry));
+    uint64_t pos = sizeof(FileHeader) + table.size() * sizeof(SectionEntry);
+    std::vector<char> zeros(alignment, 0);
+    for (uint32_t i = 0; ok && i < sections.size(); i++) {
+      ok = writeAll(fh, zeros.data(), table[i].offset - pos) &&
+           writeAll(fh, sections[i].data, sections[i].size);
+      pos = table[i].offset + sections[i].size;
+    }
+    ok = close(fh) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), filename) != 0) {
+      unlink(tmp.c_str());
+      throw "Could not write dictionary file";
+    }
+  }
+};
+
+/*
+  A read-only view of a dictionary file, either mapped from disk or over a
+  buffer the caller owns.
+*/
+class DictFileReader : public DictFile {
+ private:
+  const char *data;
+  uint64_t size;
+  bool mapped;  // true if data came from mmap and must be unmapped
+  const FileHeader *h;
+  const SectionEntry *table;
+  // of each section: 0 not checked yet, 1 good, 2 damaged. Atomic so that
+  // verify() can run on several threads at once
+  std::unique_ptr<std::atomic<uint8_t>[]> verified;
+
+  void check(uint32_t kind, uint64_t layout) {
+    if (size < sizeof(FileHeader)) throw "Not a dictionary file";
+    h = (const FileHeader *)data;
+    if (memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0)
+      throw "Not a dictionary file";
+    if (h->byteOrder != BYTE_ORDER_MARK)
+      throw "Dictionary was written on a machine with another byte order";
+    if (h->version != VERSION) throw "Unsupported dictionary file version";
+    if (h->kind != kind) throw "Wrong kind of dictionary";
+    if (h->layout != layout)
+      throw "Dictionary was built with different template parameters";
+    uint64_t tableEnd =
+        sizeof(FileHeader) + uint64_t(h->numSections) * sizeof(SectionEntry);
+    if (h->fileSize != size || tableEnd > size || h->alignment == 0)
+      throw "Dictionary file is truncated or corrupt";
+    table = (const SectionEntry *)(data + sizeof(FileHeader));
+    FileHeader copy = *h;
+    copy.headerCrc = 0;
+    if (Crc32c::compute(table, tableEnd - sizeof(FileHeader),
+                        Crc32c::compute(&copy, sizeof(copy))) != h->headerCrc)
+      throw "Dictionary file header is corrupt";
+    for (uint32_t i = 0; i < h->numSections; i++)
+      if (table[i].offset % h->alignment != 0 || table[i].offset > size ||
+          table[i].size > size - table[i].offset)
+        throw "Dictionary file is truncated or corrupt";
+    verified.reset(new std::atomic<uint8_t>[h->numSections]());
+  }
+
+ public:
+  DictFileReader()
+      : data(nullptr), size(0), mapped(false), h(nullptr), table(nullptr) {}
+  // map a file
+  void open(const char filename[], uint32_t kind, uint64_t layout) {
+    close();
+    int fh = ::open(filename, O_RDONLY);
+    if (fh < 0) throw "Could not open dictionary file";
+    struct stat st;
+    fstat(fh, &st);
+    size = st.st_size;
+    void *p = size == 0 ? MAP_FAILED
+                        : mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fh, 0);
+    ::close(fh);
+    if (p == MAP_FAILED) throw "Could not map dictionary file";
+    data = (const char *)p;
+    mapped = true;
+    check(kind, layout);
+  }
+  // use a file already in memory, which must outlive the reader
+  void open(const char buf[], uint64_t len, uint32_t kind, uint64_t layout) {
+    close();
+    data = buf;
+    size = len;
+    check(kind, layout);
+  }
+  ~DictFileReader() { close(); }
+  DictFileReader(const DictFileReader &) = delete;
+  DictFileReader &operator=(const DictFileReader &) = delete;
+
+  void close() {
+    if (mapped) munmap((void *)data, size);
+    data = nullptr;
+    size = 0;
+    mapped = false;
+  }
+  bool isOpen() const { return data != nullptr; }
+  const char *base() const { return data; }
+  uint64_t fileSize() const { return size; }
+  uint32_t numSections() const { return h->numSections; }
+  const SectionEntry &entry(uint32_t i) const { return table[i]; }
+  const FileHeader &header() const { return *h; }
+
+  /*
+    Write the same dictionary to filename with its sections on another
+    alignment. The default 4096 lets each section be mapped on its own;
+    64 keeps every struct aligned and saves up to a page per section.
+  */
+  void rewrite(const char filename[], uint32_t alignment) const {
+    DictFileWriter w(h->kind, h->layout, alignment);
+    for (uint32_t i = 0; i < h->numSections; i++)
+      w.add(table[i].id, data + table[i].offset, table[i].size);
+    w.write(filename);
+  }
+
+  // index of a section in the table, or -1 if there is none
+  int32_t find(uint32_t id) const {
+    for (uint32_t i = 0; i < h->numSections; i++)
+      if (table[i].id == id) return i;
+    return -1;
+  }
+  // a section's bytes and size, throwing if it is required but missing
+  const char *section(uint32_t id, uint64_t &len, bool required = true) const {
+    int32_t i = find(id);
+    if (i < 0) {
+      if (required) throw "Dictionary file is missing a section";
+      len = 0;
+      return nullptr;
+    }
+    len = table[i].size;
+    return data + table[i].offset;
+  }
+
+  /*
+    check one section's CRC32C, computing it only the first time (or once
+    per thread if several ask at once)
+  */
+  bool verify(uint32_t id) const {
+    int32_t i = find(id);
+    if (i < 0) return false;
+    uint8_t v = verified[i].load(std::memory_order_relaxed);
+    if (v == 0) {
+      bool ok = Crc32c::compute(data + table[i].offset, table[i].size) ==
+                table[i].crc;
+      v = ok ? 1 : 2;
+      verified[i].store(v, std::memory_order_relaxed);
+    }
+    return v == 1;
+  }
+  bool verifyAll() const {
+    bool ok = true;
+    for (uint32_t i = 0; i < h->numSections; i++) ok &= verify(table[i].id);
+    return ok;
+  }
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "Compressed3letterTrie.hh"
+#include "TrieDict.hh"
+
+/*
+  Union, intersection and difference of two dictionaries, without going
+  back to their text. Both are read in word order and merged like two
+  sorted lists straight into a new dictionary of the same kind:
+
+    compressed 3 letter   bin by bin, one bin of each decoded at a time.
+                          A bin that only one side has, or that a union or
+                          difference takes whole, is copied still packed.
+    TrieHashDict          walked in id order with select(), since ids are
+                          ranks, and the result add()ed in order
+
+  Words are compared by their codes, so both must have the same alphabet
+  (for a ByteAlphabet, the same table). The inputs can be mapped files;
+  the memory used beyond the new dictionary is one bin or one word.
+*/
+enum SetOp { SET_UNION, SET_INTERSECTION, SET_DIFFERENCE };
+
+/*
+  Merge two sorted runs of na and nb words, compare(i, j) ordering word i
+  of a against word j of b like memcmp, calling emitA(i) or emitB(j) for
+  each word of a op b.
+*/
+template <typename Compare, typename EmitA, typename EmitB>
+void mergeRuns(SetOp op, uint32_t na, uint32_t nb, Compare compare,
+               EmitA emitA, EmitB emitB) {
+  uint32_t i = 0, j = 0;
+  while (i < na || j < nb) {
+    int32_t c = i == na ? 1 : j == nb ? -1 : compare(i, j);
+    if (c < 0) {
+      if (op != SET_INTERSECTION) emitA(i);
+      i++;
+    } else if (c > 0) {
+      if (op == SET_UNION) emitB(j);
+      j++;
+    } else {
+      if (op != SET_DIFFERENCE) emitA(i);
+      i++;
+      j++;
+    }
+  }
+}
+
+template <typename Alphabet>
+bool sameAlphabet(const Alphabet &a, const Alphabet &b) {
+  return a.headerSize() == 0 ||
+         memcmp(a.header(), b.header(), a.headerSize()) == 0;
+}
+
+// the suffixes of one bin, decoded
+class DecodedBin {
+ public:
+  std::vector<uint8_t> codes;
+  std::vector<uint32_t> ends;  // ends[i] is where word i stops in codes
+
+  template <typename Reader>
+  void decode(const Reader &r, uint32_t bin) {
+    codes.clear();
+    ends.clear();
+    r.forEachSuffix(bin, [this](const uint8_t word[], uint32_t len) {
+      codes.insert(codes.end(), word, word + len);
+      ends.push_back(codes.size());
+    });
+  }
+  uint32_t size() const { return ends.size(); }
+  uint32_t start(uint32_t i) const { return i == 0 ? 0 : ends[i - 1]; }
+  uint32_t len(uint32_t i) const { return ends[i] - start(i); }
+  const uint8_t *word(uint32_t i) const { return codes.data() + start(i); }
+
+  static int32_t compare(const DecodedBin &a, uint32_t i, const DecodedBin &b,
+                         uint32_t j) {
+    return compareCodes(a.word(i), a.len(i), b.word(j), b.len(j));
+  }
+};
+
+/*
+  a op b into out, an empty CompressedDict made with the alphabet of a.
+  Write it with out.writeCompressed(filename).
+*/
+template <typename Alphabet, uint32_t hashSizeBits, uint32_t PrefixLen>
+void mergeCompressedDicts(
+    const CompressedDictReader<Alphabet, hashSizeBits, PrefixLen> &a,
+    const CompressedDictReader<Alphabet, hashSizeBits, PrefixLen> &b,
+    SetOp op, CompressedDict<Alphabet, hashSizeBits, PrefixLen> &out) {
+  using Reader = CompressedDictReader<Alphabet, hashSizeBits, PrefixLen>;
+  if (!sameAlphabet(a.getAlphabet(), b.getAlphabet()))
+    throw "the dictionaries have different alphabets";
+  DecodedBin x, y;
+  for (uint32_t bin = 0; bin < Reader::FIRST_N; bin++) {
+    uint32_t na = a.blocks(bin), nb = b.blocks(bin);
+    if (na == 0 && nb == 0) continue;
+    // a bin the result takes whole from one side stays packed
+    if (nb == 0 || (na == 0 && op == SET_UNION)) {
+      if (op != SET_INTERSECTION) {
+        if (nb == 0)
+          out.copyBin(bin, a.binWords(bin), na);
+        else
+          out.copyBin(bin, b.binWords(bin), nb);
+      }
+      continue;
+    }
+    if (na == 0) continue;  // nothing of a, so nothing to intersect or keep
+    x.decode(a, bin);
+    y.decode(b, bin);
+    mergeRuns(
+        op, x.size(), y.size(),
+        [&x, &y](uint32_t i, uint32_t j) {
+          return DecodedBin::compare(x, i, y, j);
+        },
+        [&out, &x, bin](uint32_t i) { out.add(bin, x.word(i), x.len(i)); },
+        [&out, &y, bin](uint32_t j) { out.add(bin, y.word(j), y.len(j)); });
+  }
+}
+
+/*
+  a op b into out, an empty dictionary of the same type. Save it with
+  out.save(filename).
+*/
+template <typename Dict>
+void mergeTrieHashDicts(const Dict &a, const Dict &b, SetOp op, Dict &out) {
+  if (out.numWords() != 0) throw "merge needs an empty dictionary";
+  if (!sameAlphabet(a.getAlphabet(), b.getAlphabet()))
+    throw "the dictionaries have different alphabets";
+  out.setAlphabet(a.getAlphabet());
+  const auto &alphabet = a.getAlphabet();
+  // the word of each side last selected, so each is decoded once
+  struct Cursor {
+    const Dict &d;
+    uint32_t id = 0, len = 0;
+    char word[Dict::MAX_WORD];
+    Cursor(const Dict &d) : d(d) {}
+    void at(uint32_t i) {
+      if (id != i + 1) len = d.select(id = i + 1, word);
+    }
+  } x(a), y(b);
+  mergeRuns(
+      op, a.numWords(), b.numWords(),
+      [&x, &y, &alphabet](uint32_t i, uint32_t j) {
+        x.at(i);
+        y.at(j);
+        for (uint32_t k = 0; k < x.len && k < y.len; k++) {
+          int32_t c = alphabet.index(x.word[k]) - alphabet.index(y.word[k]);
+          if (c != 0) return c;
+        }
+        return int32_t(x.len) - int32_t(y.len);
+      },
+      [&out, &x](uint32_t i) {
+        x.at(i);
+        out.add(x.word, x.len);
+      },
+      [&out, &y](uint32_t j) {
+        y.at(j);
+        out.add(y.word, y.len);
+      });
+}
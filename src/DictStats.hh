@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+/*
+  Counters for the hot paths of the dictionaries. They only exist when
+  compiled with -DTRIEHASH_STATS. Otherwise TRIEHASH_STAT(...) expands to
+  nothing and the lookups are exactly the same code as without them.
+
+  The counters are plain integers, not atomics. Give each thread its own
+  dictionary or only read them from a single-threaded run. A LookupCache
+  belongs to one thread anyway, so it always counts its hits and misses
+  here; add up the stats of the threads with +=.
+*/
+#ifdef TRIEHASH_STATS
+#define TRIEHASH_STAT(x) x
+#else
+#define TRIEHASH_STAT(x)
+#endif
+
+class LookupStats {
+ public:
+  static constexpr uint32_t HIST = 32;  // the last bin counts HIST-1 or more
+
+  uint64_t hitProbes[HIST];   // hitProbes[n] = hits that looked at n nodes
+  uint64_t missProbes[HIST];  // same for misses that reached a hash map
+  uint64_t directoryMisses;   // misses decided by the directory alone
+  uint64_t hotHits;           // hits answered by the hot word table
+  uint64_t filterRejects;     // misses decided by the filter
+  uint64_t cacheHits;         // lookups answered by a LookupCache
+  uint64_t cacheMisses;       // lookups a LookupCache passed on
+  uint64_t textCompares;      // nodes whose text had to be compared
+  uint64_t grows;             // times a hash map doubled while building
+  uint64_t rehashed;          // nodes reinserted by those grows
+
+  LookupStats() { clear(); }
+  void clear() { memset(this, 0, sizeof(*this)); }
+
+  void hit(uint32_t probes) { hitProbes[probes < HIST ? probes : HIST - 1]++; }
+  void miss(uint32_t probes) {
+    missProbes[probes < HIST ? probes : HIST - 1]++;
+  }
+
+  double cacheHitRate() const {
+    uint64_t n = cacheHits + cacheMisses;
+    return n == 0 ? 0 : double(cacheHits) / n;
+  }
+  // add the counts of another, eg of another thread
+  LookupStats &operator+=(const LookupStats &o) {
+    for (uint32_t i = 0; i < HIST; i++) {
+      hitProbes[i] += o.hitProbes[i];
+      missProbes[i] += o.missProbes[i];
+    }
+    directoryMisses += o.directoryMisses;
+    hotHits += o.hotHits;
+    filterRejects += o.filterRejects;
+    cacheHits += o.cacheHits;
+    cacheMisses += o.cacheMisses;
+    textCompares += o.textCompares;
+    grows += o.grows;
+    rehashed += o.rehashed;
+    return *this;
+  }
+
+  static uint64_t total(const uint64_t hist[HIST]) {
+    uint64_t n = 0;
+    for (uint32_t i = 0; i < HIST; i++) n += hist[i];
+    return n;
+  }
+  static double mean(const uint64_t hist[HIST]) {
+    uint64_t n = 0, sum = 0;
+    for (uint32_t i = 0; i < HIST; i++) {
+      n += hist[i];
+      sum += i * hist[i];
+    }
+    return n == 0 ? 0 : double(sum) / n;
+  }
+
+  static void printHistogram(std::ostream &s, const char name[],
+                             const uint64_t hist[HIST]) {
+    uint64_t n = total(hist);
+    s << name << ": " << n << " lookups, mean " << std::fixed
+      << std::setprecision(3) << mean(hist) << " probes\n";
+    for (uint32_t i = 0; i < HIST; i++)
+      if (hist[i] != 0)
+        s << std::setw(6) << i << (i == HIST - 1 ? "+" : " ") << std::setw(12)
+          << hist[i] << std::setw(10) << std::setprecision(2)
+          << 100.0 * hist[i] / n << "%\n";
+  }
+
+  friend std::ostream &operator<<(std::ostream &s, const LookupStats &st) {
+    printHistogram(s, "hits", st.hitProbes);
+    printHistogram(s, "misses", st.missProbes);
+    return s << "directory misses: " << st.directoryMisses
+             << "\nhot table hits: " << st.hotHits
+             << "\nfilter rejects: " << st.filterRejects
+             << "\ncache hits: " << st.cacheHits
+             << " misses: " << st.cacheMisses
+             << " hit rate: " << std::setprecision(2)
+             << 100 * st.cacheHitRate() << '%'
+             << "\ntext compares: " << st.textCompares
+             << "\ngrows: " << st.grows << " rehashed nodes: " << st.rehashed
+             << '\n';
+  }
+};
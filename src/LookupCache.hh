@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "DictStats.hh"
+#include "WordHash.hh"
+
+/*
+  A small direct-mapped cache of lookup results in front of a dictionary,
+  for text that repeats the same words over and over. Each entry holds a
+  whole word and its id (0 for a word that is not in the dictionary, so
+  misses are remembered too), and a word can only ever be in the entry its
+  hash picks, so a lookup is a hash, one line and a compare. A different
+  word landing in the entry replaces it. Words longer than MAX_WORD are
+  passed straight through.
+
+  A cache is not shared: give each thread its own, like CorpusPipeline does.
+  Dict is anything with get(word, len, id) const, and getBatch as well to
+  use the cache's getBatch. The dictionary must not change while cached.
+
+  The hits and misses of the cache are always counted (it belongs to one
+  thread, so these are plain increments) in the cacheHits and cacheMisses
+  of a LookupStats.
+*/
+template <typename Dict>
+class LookupCache {
+ public:
+  struct Entry {
+    uint32_t id;
+    uint8_t len;  // 0 if the entry is empty
+    char word[27];
+  };
+  static constexpr uint32_t MAX_WORD = sizeof(Entry::word);
+
+ private:
+  const Dict &dict;
+  std::vector<Entry> entries;
+  uint32_t mask;
+  LookupStats stats;
+  std::vector<uint32_t> missed;  // getBatch's words that were not cached
+  std::vector<const char *> missWords;
+  std::vector<uint32_t> missLens;
+  std::vector<uint32_t> missIds;
+
+  Entry &entry(const char word[], uint32_t len) {
+    return entries[uint32_t(WordHash::hash(word, len)) & mask];
+  }
+  static bool holds(const Entry &e, const char word[], uint32_t len) {
+    return e.len == len && memcmp(e.word, word, len) == 0;
+  }
+  static void fill(Entry &e, const char word[], uint32_t len, uint32_t id) {
+    e.id = id;
+    e.len = len;
+    memcpy(e.word, word, len);
+  }
+
+ public:
+  // size is the number of entries, a power of 2
+  LookupCache(const Dict &dict, uint32_t size = 4096)
+      : dict(dict), entries(size), mask(size - 1) {
+    if (size == 0 || (size & (size - 1)) != 0)
+      throw "cache size must be a power of 2";
+  }
+
+  bool get(const char word[], uint32_t len, uint32_t &id) {
+    if (len == 0 || len > MAX_WORD) return dict.get(word, len, id);
+    Entry &e = entry(word, len);
+    if (holds(e, word, len)) {
+      stats.cacheHits++;
+      id = e.id;
+      return id != 0;
+    }
+    stats.cacheMisses++;
+    uint32_t found = 0;
+    bool ok = dict.get(word, len, found);
+    fill(e, word, len, ok ? found : 0);
+    if (ok) id = found;
+    return ok;
+  }
+
+  /*
+    Dict::getBatch with the cache in front: the words found in the cache are
+    answered at once and the rest go to the dictionary in one batch, so
+    their misses still overlap. Returns the number of words found.
+  */
+  uint32_t getBatch(const char *const words[], const uint32_t lens[],
+                    uint32_t n, uint32_t ids[]) {
+    uint32_t found = 0;
+    missed.clear();
+    missWords.clear();
+    missLens.clear();
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t len = lens[i];
+      if (len != 0 && len <= MAX_WORD) {
+        const Entry &e = entry(words[i], len);
+        if (holds(e, words[i], len)) {
+          stats.cacheHits++;
+          ids[i] = e.id;
+          found += e.id != 0;
+          continue;
+        }
+        stats.cacheMisses++;
+      }
+      missed.push_back(i);
+      missWords.push_back(words[i]);
+      missLens.push_back(len);
+    }
+    missIds.resize(missed.size());
+    found += dict.getBatch(missWords.data(), missLens.data(), missed.size(),
+                           missIds.data());
+    for (uint32_t k = 0; k < missed.size(); k++) {
+      uint32_t i = missed[k];
+      ids[i] = missIds[k];
+      if (lens[i] != 0 && lens[i] <= MAX_WORD)
+        fill(entry(words[i], lens[i]), words[i], lens[i], ids[i]);
+    }
+    return found;
+  }
+
+  void clear() {
+    for (Entry &e : entries) e.len = 0;
+  }
+  uint32_t size() const { return mask + 1; }
+  const LookupStats &getStats() const { return stats; }
+  void clearStats() { stats.clear(); }
+};
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "TrieDict.hh"
+
+/*
+  Several related dictionaries (a base language and the vocabularies of
+  some domains, say) in one image. Their words are stored once, in one
+  dictionary of the union with one directory and one text, and each word
+  carries a mask of the dictionaries it is in. So a single lookup says
+  which dictionaries contain a word, instead of one lookup per dictionary,
+  and the words they share take their space once.
+
+  The image is a TrieHashDict file of the union plus two sections:
+
+    SECTION_MEMBERS   numDicts and maskBytes, then maskBytes bytes per id
+                      from id 0, bit k set if dictionary k has the word
+    SECTION_NAMES     the names of the dictionaries, each ending in '\0'
+
+  so any TrieHashDict can open it too and sees the union. Ids are the ranks
+  of the words in the union.
+*/
+template <typename Dict = TrieHashDict>
+class BasicMultiDict {
+ public:
+  static constexpr uint32_t MAX_DICTS = 64;
+
+ private:
+  using Alphabet = std::decay_t<decltype(std::declval<Dict>().getAlphabet())>;
+  struct MembersHeader {
+    uint32_t numDicts;
+    uint32_t maskBytes;
+  };
+
+  std::unique_ptr<Dict> dict;
+  MembersHeader members;
+  const uint8_t *masks;              // maskBytes per id
+  std::vector<uint8_t> membersTable;  // owns masks while building
+  std::vector<std::string> names;
+
+  uint64_t maskOf(uint32_t id) const {
+    uint64_t m = 0;
+    memcpy(&m, masks + uint64_t(id) * members.maskBytes, members.maskBytes);
+    return m;
+  }
+
+ public:
+  /*
+    Build from word lists, one per dictionary, each a file of words
+    separated by white space in any order. names[k] names files[k].
+  */
+  BasicMultiDict(const std::vector<std::string> &names,
+                 const std::vector<std::string> &files)
+      : names(names) {
+    if (files.empty() || files.size() > MAX_DICTS)
+      throw "a MultiDict holds 1 to 64 dictionaries";
+    if (names.size() != files.size()) throw "a name is needed for each file";
+    std::string buf;
+    std::vector<uint64_t> ends;  // of each file in buf
+    for (const std::string &f : files) {
+      std::ifstream in(f, std::ios::binary);
+      if (!in) throw "Error, can't load file";
+      buf.append(std::istreambuf_iterator<char>(in),
+                 std::istreambuf_iterator<char>());
+      buf += '\n';
+      ends.push_back(buf.size());
+    }
+    Alphabet alphabet;
+    if constexpr (Alphabet::remaps) alphabet.build(buf.data(), buf.size());
+
+    struct Word {
+      uint64_t start;
+      uint32_t len, which;
+    };
+    std::vector<Word> words;
+    Tokenizer<NON_SPACE> tok(buf.data(), buf.size());
+    uint32_t which = 0;
+    for (Tokenizer<NON_SPACE>::Span w; tok.next(w);) {
+      while (w.start >= ends[which]) which++;
+      words.push_back({w.start, w.len, which});
+    }
+    const char *text = buf.data();
+    std::sort(words.begin(), words.end(),
+              [text, &alphabet](const Word &a, const Word &b) {
+                return std::lexicographical_compare(
+                    text + a.start, text + a.start + a.len, text + b.start,
+                    text + b.start + b.len, [&alphabet](char x, char y) {
+                      return alphabet.index(x) < alphabet.index(y);
+                    });
+              });
+
+    uint64_t letters = 0;
+    for (const Word &w : words) letters += w.len;
+    dict.reset(new Dict(uint64_t(words.size()), letters));
+    dict->setAlphabet(alphabet);
+    members.numDicts = files.size();
+    members.maskBytes = (files.size() + 7) / 8;
+    membersTable.assign(members.maskBytes, 0);  // for id 0, no word
+    uint64_t mask = 0;
+    for (size_t i = 0; i < words.size(); i++) {
+      const Word &w = words[i];
+      mask |= 1ULL << w.which;
+      if (i + 1 < words.size() && words[i + 1].len == w.len &&
+          memcmp(text + words[i + 1].start, text + w.start, w.len) == 0)
+        continue;  // the same word from another list
+      dict->add(text + w.start, w.len);
+      membersTable.insert(membersTable.end(), (uint8_t *)&mask,
+                          (uint8_t *)&mask + members.maskBytes);
+      mask = 0;
+    }
+    masks = membersTable.data();
+  }
+
+  // map an image written by save()
+  BasicMultiDict(const char filename[]) : dict(new Dict(filename)) {
+    const DictFileReader &file = dict->image();
+    uint64_t len;
+    const char *p = file.section(SECTION_MEMBERS, len);
+    if (len < sizeof(MembersHeader)) throw "Dictionary file is corrupt";
+    memcpy(&members, p, sizeof(MembersHeader));
+    masks = (const uint8_t *)p + sizeof(MembersHeader);
+    if (members.numDicts == 0 || members.numDicts > MAX_DICTS ||
+        members.maskBytes != (members.numDicts + 7) / 8 ||
+        len != sizeof(MembersHeader) +
+                   uint64_t(dict->numWords() + 1) * members.maskBytes)
+      throw "Dictionary file is corrupt";
+    p = file.section(SECTION_NAMES, len);
+    for (const char *end = p + len; p < end;) {
+      const char *z = (const char *)memchr(p, '\0', end - p);
+      if (z == nullptr) throw "Dictionary file is corrupt";
+      names.emplace_back(p, z);
+      p = z + 1;
+    }
+    if (names.size() != members.numDicts) throw "Dictionary file is corrupt";
+  }
+
+  void save(const char filename[]) {
+    std::string allNames;
+    for (const std::string &n : names)
+      allNames.append(n.c_str(), n.size() + 1);
+    DictFileWriter w(DICT_TRIEHASH, Dict::layout());
+    dict->addSections(w);
+    std::vector<uint8_t> section((const uint8_t *)&members,
+                                 (const uint8_t *)(&members + 1));
+    section.insert(section.end(), masks,
+                   masks + uint64_t(dict->numWords() + 1) * members.maskBytes);
+    w.add(SECTION_MEMBERS, section.data(), section.size());
+    w.add(SECTION_NAMES, allNames.data(), allNames.size());
+    w.write(filename);
+  }
+
+  /*
+    The dictionaries containing word, bit k for dictionary k, 0 if none
+    does. id is the word's id in the union.
+  */
+  uint64_t which(const char word[], uint32_t len, uint32_t &id) const {
+    if (!dict->get(word, len, id)) return 0;
+    return maskOf(id);
+  }
+  uint64_t which(const char word[], uint32_t len) const {
+    uint32_t id;
+    return which(word, len, id);
+  }
+  bool contains(uint32_t k, const char word[], uint32_t len) const {
+    return (which(word, len) >> k & 1) != 0;
+  }
+
+  uint32_t numDictionaries() const { return members.numDicts; }
+  const std::string &name(uint32_t k) const { return names[k]; }
+  // -1 if no dictionary has that name
+  int32_t find(const std::string &name) const {
+    for (uint32_t k = 0; k < names.size(); k++)
+      if (names[k] == name) return k;
+    return -1;
+  }
+  // the union of all the dictionaries
+  const Dict &getDict() const { return *dict; }
+  uint64_t imageSize() const {
+    uint64_t n = 0;
+    for (const std::string &s : names) n += s.size() + 1;
+    return dict->imageSize() + sizeof(MembersHeader) +
+           uint64_t(dict->numWords() + 1) * members.maskBytes + n;
+  }
+};
+
+using MultiDict = BasicMultiDict<>;
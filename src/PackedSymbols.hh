@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/*
+  Words are stored in the compressed dictionaries as a sequence of symbol
+  codes, each word ending with the END token, packed in base
+  (AlphabetSize + 1) into 64-bit blocks. For 26 letters that is base 27 and
+  13 symbols per block with just over 1 bit to spare:
+
+     27^13 = 4.05 * 10^18 < 2^64 = 1.84 * 10^19 < 27^14
+
+  Everything else is derived from the alphabet size at compile time so a
+  different alphabet changes the packing with no runtime cost.
+*/
+template <uint32_t AlphabetSize>
+class SymbolPacking {
+ private:
+  // the largest k with b^k <= 2^64, ie k digits fit in a 64-bit block
+  static constexpr uint32_t countPerWord(uint64_t b) {
+    uint32_t k = 0;
+    for (uint64_t p = 1; p <= ~0ULL / b; p *= b) k++;
+    return k;
+  }
+  static constexpr uint64_t power(uint64_t b, uint32_t n) {
+    return n == 0 ? 1 : b * power(b, n - 1);
+  }
+
+ public:
+  static constexpr uint64_t base = AlphabetSize + 1;
+  static constexpr uint8_t END = base - 1;  // end of word token
+  static constexpr uint32_t perWord = countPerWord(base);
+  // place value of the last digit in a block
+  static constexpr uint64_t top = power(base, perWord - 1);
+  static_assert(AlphabetSize >= 2 && AlphabetSize < 255, "alphabet size");
+
+  // split a block into its digits, lowest first
+  static void unpack(uint64_t w, uint8_t digits[perWord]) {
+    for (uint32_t i = 0; i < perWord - 1; i++) {
+      digits[i] = w % base;
+      w /= base;
+    }
+    digits[perWord - 1] = w;
+  }
+};
+
+// order two words by their codes like memcmp, a prefix first
+inline int32_t compareCodes(const uint8_t a[], uint32_t la, const uint8_t b[],
+                            uint32_t lb) {
+  // an empty word may have no codes at all, and memcmp wants real pointers
+  int32_t c = la == 0 || lb == 0 ? 0 : memcmp(a, b, la < lb ? la : lb);
+  return c != 0 ? c : la == lb ? 0 : la < lb ? -1 : 1;
+}
+
+/*
+  The words of a run of packed blocks, in order, as the codes before each
+  END. Blocks are unpacked four at a time into a buffer and the ENDs found
+  with memchr, which scans the digits 16 or 32 at a time with SIMD, so a
+  search goes from word to word instead of testing every digit. Words of
+  up to MAX_WORD codes.
+*/
+template <uint32_t AlphabetSize>
+class PackedWordCursor {
+ private:
+  using P = SymbolPacking<AlphabetSize>;
+  static constexpr uint32_t MAX_WORD = 256;
+  const uint64_t *at, *stop;
+  uint32_t pos, filled;
+  uint8_t buf[MAX_WORD + 4 * P::perWord];
+
+ public:
+  PackedWordCursor(const uint64_t *begin, const uint64_t *end)
+      : at(begin), stop(end), pos(0), filled(0) {}
+
+  // the next word, valid until the next call; false after the last
+  bool next(const uint8_t *&word, uint32_t &len) {
+    for (;;) {
+      const uint8_t *end =
+          (const uint8_t *)memchr(buf + pos, P::END, filled - pos);
+      if (end != nullptr) {
+        word = buf + pos;
+        len = end - word;
+        pos = end - buf + 1;
+        return true;
+      }
+      if (at == stop) return false;  // any digits left are padding
+      if (filled - pos > MAX_WORD) throw "word too long";
+      memmove(buf, buf + pos, filled - pos);
+      filled -= pos;
+      pos = 0;
+      for (uint32_t i = 0; i < 4 && at != stop; i++) {
+        P::unpack(*at++, buf + filled);
+        filled += P::perWord;
+      }
+    }
+  }
+};
+
+/*
+  Append symbol codes to a vector of packed blocks. flush() writes out a
+  partial block so that a bucket can start on a fresh one. The unused digits
+  are 0 with no END after them, so a decoder sees no word there.
+*/
+template <uint32_t AlphabetSize>
+class SymbolPacker {
+ private:
+  using P = SymbolPacking<AlphabetSize>;
+  std::vector<uint64_t> &blocks;
+  uint64_t current;
+  uint64_t power;
+
+ public:
+  SymbolPacker(std::vector<uint64_t> &blocks)
+      : blocks(blocks), current(0), power(1) {}
+
+  inline void put(uint8_t code) {
+    current += code * power;
+    if (power < P::top) {
+      power *= P::base;
+    } else {
+      blocks.push_back(current);
+      power = 1;
+      current = 0;
+    }
+  }
+  void flush() {
+    if (power == 1) return;
+    blocks.push_back(current);
+    power = 1;
+    current = 0;
+  }
+};
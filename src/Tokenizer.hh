@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+  Split text into words 32 bytes at a time.
+
+  Each block of 32 bytes is classified into a mask with one bit per byte,
+  set if the byte belongs to a word: two compares and a movemask with AVX2,
+  twice that with SSE2, a loop otherwise. Words are then read off the mask
+  with count trailing zeros, so runs of letters or of spaces cost nothing
+  per byte. The last partial block is copied into a padded buffer, so no
+  byte past the end of the text is ever read.
+
+  NON_SPACE words are runs of bytes above ' ', what the dictionary builders
+  read (one word per line, any bytes, UTF-8 included). LETTERS words are runs
+  of a-z in either case, what the corpus pipeline reads; given a lowered
+  buffer of the same length, the tokenizer also writes the text with the
+  letters lowered to it as it goes.
+
+    Tokenizer<NON_SPACE> tok(buf, len);
+    for (Tokenizer<NON_SPACE>::Span w; tok.next(w);)
+      add(buf + w.start, w.len);
+*/
+enum WordChars { NON_SPACE, LETTERS };
+
+template <WordChars Kind = NON_SPACE>
+class Tokenizer {
+ public:
+  struct Span {
+    uint64_t start;
+    uint32_t len;
+  };
+  static constexpr uint32_t BLOCK = 32;
+
+ private:
+  const char *text;
+  uint64_t len;
+  char *lowered;
+  uint64_t blockStart;  // the block whose mask is in bits
+  uint32_t bits;        // word bytes of that block, only the valid ones set
+  uint32_t valid;       // bits for the bytes of the block inside the text
+  uint64_t pos;         // where the search for the next word starts
+
+  void load(uint64_t at) {
+    uint64_t n = len - at < BLOCK ? len - at : BLOCK;
+    const char *p = text + at;
+    char block[BLOCK];
+    if (n < BLOCK) {
+      memset(block, 0, BLOCK);
+      memcpy(block, p, n);
+      p = block;
+    }
+    char lower[BLOCK];
+    bool lowering = Kind == LETTERS && lowered != nullptr;
+    bits = classify(p, lowering ? lower : nullptr);
+    if (lowering) memcpy(lowered + at, lower, n);
+    valid = n == BLOCK ? ~0U : (1U << n) - 1;
+    bits &= valid;
+    blockStart = at;
+  }
+  // the first byte at or after from that is in a word (want) or not
+  uint64_t find(uint64_t from, bool want) {
+    while (from < len) {
+      uint64_t at = from & ~uint64_t(BLOCK - 1);
+      if (at != blockStart) load(at);
+      uint32_t m = (want ? bits : ~bits & valid) >> (from - at);
+      if (m != 0) return from + __builtin_ctz(m);
+      from = at + BLOCK;
+    }
+    return len;
+  }
+
+ public:
+  /*
+    lowered, if given, must hold len bytes. It is only written for LETTERS,
+    and only the bytes of words are meaningful.
+  */
+  Tokenizer(const char text[], uint64_t len, char lowered[] = nullptr)
+      : text(text),
+        len(len),
+        lowered(lowered),
+        blockStart(~0ULL),
+        bits(0),
+        valid(0),
+        pos(0) {}
+
+  // the next word, false at the end of the text
+  bool next(Span &w) {
+    uint64_t start = find(pos, true);
+    if (start >= len) return false;
+    pos = find(start, false);
+    w.start = start;
+    w.len = pos - start;
+    return true;
+  }
+
+  /*
+    The word bits of 32 bytes at p. For LETTERS, lower gets the bytes with
+    0x20 set, which lowers the letters (and changes nothing that matters).
+  */
+  static uint32_t classify(const char p[BLOCK], char lower[BLOCK]) {
+#ifdef __AVX2__
+    __m256i x = _mm256_loadu_si256((const __m256i *)p);
+    if constexpr (Kind == NON_SPACE) {
+      // unsigned x > ' ': max(x, '!') == x
+      __m256i m =
+          _mm256_cmpeq_epi8(_mm256_max_epu8(x, _mm256_set1_epi8('!')), x);
+      return _mm256_movemask_epi8(m);
+    } else {
+      __m256i l = _mm256_or_si256(x, _mm256_set1_epi8(0x20));
+      if (lower != nullptr) _mm256_storeu_si256((__m256i *)lower, l);
+      // bytes of 0x80 and above are negative, so never letters
+      __m256i m = _mm256_and_si256(
+          _mm256_cmpgt_epi8(l, _mm256_set1_epi8('a' - 1)),
+          _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), l));
+      return _mm256_movemask_epi8(m);
+    }
+#elif defined(__SSE2__)
+    uint32_t mask = 0;
+    for (uint32_t h = 0; h < BLOCK; h += 16) {
+      __m128i x = _mm_loadu_si128((const __m128i *)(p + h));
+      __m128i m;
+      if constexpr (Kind == NON_SPACE) {
+        m = _mm_cmpeq_epi8(_mm_max_epu8(x, _mm_set1_epi8('!')), x);
+      } else {
+        __m128i l = _mm_or_si128(x, _mm_set1_epi8(0x20));
+        if (lower != nullptr) _mm_storeu_si128((__m128i *)(lower + h), l);
+        m = _mm_and_si128(_mm_cmpgt_epi8(l, _mm_set1_epi8('a' - 1)),
+                          _mm_cmplt_epi8(l, _mm_set1_epi8('z' + 1)));
+      }
+      mask |= uint32_t(_mm_movemask_epi8(m)) << h;
+    }
+    return mask;
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < BLOCK; i++) {
+      bool in;
+      if constexpr (Kind == NON_SPACE) {
+        in = uint8_t(p[i]) > ' ';
+      } else {
+        if (lower != nullptr) lower[i] = p[i] | 0x20;
+        in = uint8_t((p[i] | 0x20) - 'a') < 26;
+      }
+      mask |= uint32_t(in) << i;
+    }
+    return mask;
+#endif
+  }
+};
@@ -1,14 +1,80 @@
-//#pragma once
+#pragma once
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
-class TrieHashDict {
+#include "Alphabet.hh"
+#include "AsyncLoader.hh"
+#include "CoroLookup.hh"
+#include "DictFile.hh"
+#include "DictStats.hh"
+#include "Tokenizer.hh"
+#include "WordFilter.hh"
+#include "WordHash.hh"
+
+/*
+  The first 3 letters of each word select a hash map. Rather than reserving a
+  HashMap header for all 26*26*26 trigrams (most of which never occur), the
+  trigrams are kept in a compact directory: a presence bitmap of FIRST_3 bits
+  stored 64 at a time, each 64-bit word paired with the number of hash maps
+  present before it. The index of a trigram's HashMap in the dense array is
+
+     rank + popcount(present & bits below this trigram)
+
+  The whole directory is 275 * 16 = 4400 bytes, so it stays in L1, and only
+  hash maps that actually exist are stored or loaded.
+
+  The letters are symbol codes of an Alphabet (see Alphabet.hh). Alpha26 is
+  the default and compiles down to the original c - 'a' arithmetic; a
+  ByteAlphabet accepts any bytes, and its symbol table is saved right after
+  Info in the file.
+
+  The rest of the shape is fixed at compile time too: PrefixLen letters select
+  the hash map (3 by default, so the comments say trigram), Offset is the
+  width of the text offset within a hash map and RelId the width of an id
+  within it, and MaxBucket the most words a single hash map may hold. The
+  16-bit default keeps a node to 4 bytes, which suits a dictionary like
+  dict.txt; TrieHashDict32 has 8-byte nodes and no 64k limits for huge ones.
+  Building checks the limits, lookups have no branches for them. Hash hashes
+  the suffixes (see WordHash.hh), the same function for building and lookup.
+
+  Given how often each word is looked up, prioritize() lays every hash map
+  out again with the most frequent words inserted first, so they sit in
+  their home slot and a hit on them is one probe. The most frequent short
+  words are also copied whole into a small hot table (two per cache line)
+  that get() checks before anything else, so for Zipfian traffic most
+  lookups touch a single line. The hot table is saved with the image.
+
+  buildFilter() (or save with bits per word) adds a blocked Bloom filter
+  of all the words (see WordFilter.hh), checked before the directory, so
+  most misses cost one hash and one cache line of the filter.
+
+  Words must be added in sorted order (of the alphabet codes), and ids are
+  given in that order starting at 1, so the id of a word is its rank and
+  the words starting with any prefix have a contiguous range of ids: see
+  rank, select and prefixToIdRange. Words shorter than PrefixLen have no
+  hash map; they are kept in a small sorted array of their own, taking
+  their ids in order like the rest.
+*/
+template <typename Alphabet = Alpha26, uint32_t PrefixLen = 3,
+          typename Offset = uint16_t, typename RelId = uint16_t,
+          uint32_t MaxBucket = std::numeric_limits<RelId>::max(),
+          typename Hash = WordHash>
+class BasicTrieHashDict {
  private:
   //  static constexpr int scale = 8; // we are using 32-bit offsets in each
   //  hash table, offset by 16 bits within each word
@@ -21,47 +87,153 @@ class TrieHashDict {
     uint32_t textSize;  // the number of bytes of text needed to store
                         // note this is without the first 3 letters
   };
+  struct DirectoryWord {
+    uint64_t present;  // bit i set if trigram 64*k+i has a hash map
+    uint32_t rank;     // number of hash maps in all preceding words
+    uint32_t unused;   // pad to 16 bytes so a word never straddles a line
+  };
+  // a hot word stored whole, as it is looked up, not as text codes
+  struct HotEntry {
+    uint32_t id;  // 0 if the entry is empty
+    uint8_t len;
+    char word[27];
+  };
+  constexpr static uint32_t HOT_WORD = sizeof(HotEntry::word);
+  // a word shorter than PrefixLen, as alphabet codes
+  struct ShortWord {
+    uint32_t id;
+    uint8_t len;
+    uint8_t codes[PrefixLen > 1 ? PrefixLen - 1 : 1];
+  };
   Info info;
-  Info *pInfo;  // pointer that owns the memory
+  Alphabet alphabet;
+  Info *pInfo;          // pointer that owns the memory while building
+  DictFileReader file;  // the mapped image of a loaded dictionary
+  AsyncLoader *loader;  // reading the image in the background, or nullptr
+  const HotEntry *hot;  // the hot word table, or nullptr if there is none
+  uint32_t hotMask;     // its size - 1
+  std::vector<HotEntry> hotTable;  // owns hot while building
+  const WordFilter::Block *filter;   // nullptr if there is no filter
+  uint32_t filterBlocks;
+  std::vector<WordFilter::Block> filterTable;  // owns filter while building
+  const ShortWord *shorts;  // sorted, so by word and by id alike
+  uint32_t numShorts;
+  std::vector<ShortWord> shortWords;  // owns shorts while building
+  std::string lastWord;  // codes of the last word added, to check the order
+  /*
+    For every RANK_STEP-th id, where its suffix is in the text of its hash
+    map (relative to base, 1 for the empty suffix, 0 for a short word). The
+    words of a hash map are in the text in id order, so any id is at most
+    RANK_STEP - 1 words past a sample.
+  */
+  constexpr static uint32_t RANK_STEP = 8;
+  const Offset *samples;
+  std::vector<Offset> rankSamples;  // owns samples while building
   char *text;   // the text of the hash maps in a single huge block.
   // No leading chars because the trie manages those
   // each word ends with the high bit set
 
   class HashMap;
   class HashMapNode;
-  // TODO: how to handle 1 and 2 letter words
-  HashMap *hashmaps;
+  DirectoryWord *directory;
+  HashMap *hashmaps;  // dense, only the trigrams present, in trigram order
   HashMapNode *nodes;
   int32_t lastHashMap;
   uint32_t startIndexOfCurrentHashMap;
   uint32_t wordsInCurrentHashMap;
-  HashMapNode *temp;
-  constexpr static uint32_t FIRST_3 = 26 * 26 * 26;
-  uint32_t whichHash(const char w[]) {
-    return ((w[0] - 'a') * 26 + (w[1] - 'a')) * 26 + w[2] - 'a';
+  bool sealed;  // by shrinkToFit, relayout or loadBins, then add() throws
+  constexpr static uint32_t power(uint32_t b, uint32_t n) {
+    return n == 0 ? 1 : b * power(b, n - 1);
+  }
+  constexpr static uint32_t FIRST_N = power(Alphabet::size, PrefixLen);
+  constexpr static uint32_t DIRECTORY_WORDS = (FIRST_N + 63) / 64;
+  static_assert(PrefixLen >= 1 && FIRST_N / Alphabet::size ==
+                                      power(Alphabet::size, PrefixLen - 1),
+                "too many prefixes");
+  static_assert(MaxBucket - 1 <= std::numeric_limits<RelId>::max(),
+                "ids in a bucket must fit in RelId");
+  constexpr static uint32_t directorySize =
+      DIRECTORY_WORDS * sizeof(DirectoryWord);
+  // the number of the first PrefixLen letters, or -1 if any is not a symbol
+  int32_t whichHash(const char w[]) const {
+    int32_t which = 0, bad = 0;
+    for (uint32_t i = 0; i < PrefixLen; i++) {
+      int32_t c = alphabet.index(w[i]);
+      bad |= c;
+      which = which * Alphabet::size + c;
+    }
+    return bad < 0 ? -1 : which;
+  }
+  /*
+    The text holds alphabet codes. For Alpha26 they are the letters, so the
+    suffix is used in place, otherwise it is translated into buf. Returns
+    nullptr if a byte is not in the alphabet or the word is too long.
+  */
+  const char *encodeSuffix(const char suffix[], uint32_t len,
+                           char buf[256]) const {
+    if constexpr (!Alphabet::remaps) {
+      return suffix;
+    } else {
+      if (len > 256) return nullptr;
+      for (uint32_t i = 0; i < len; i++) {
+        int32_t code = alphabet.index(suffix[i]);
+        if (code < 0) return nullptr;
+        buf[i] = code;
+      }
+      return buf;
+    }
   }
   uint32_t nodeCapacity;
+  uint32_t textCapacity;
+  uint32_t mapCapacity;
+  // where the text of each hash map ends, if relayout() moved them out of
+  // order; empty when each ends where the next one's begins
+  std::vector<uint32_t> textEnds;
+#ifdef TRIEHASH_STATS
+  mutable LookupStats stats;
+#endif
 
- public:
-  TrieHashDict() {
-    info.numHashMaps = FIRST_3;
-    info.numWords = 213000;
-    info.nodeSize = 0;
-    info.nodeSize = 0;
-    uint32_t textSize = info.numWords * 6;
-    nodeCapacity = info.numWords * 2;
-    uint32_t hashMapNodeSize = info.nodeSize * sizeof(HashMapNode);
-    text = new char[sizeof(Info) + textSize + hashMapOffset +
-                    nodeCapacity * sizeof(HashMapNode)];
+  // return the hash map for a trigram, or nullptr if no word starts with it
+  const HashMap *findHashMap(uint32_t which) const {
+    const DirectoryWord &d = directory[which >> 6];
+    uint64_t bit = 1ULL << (which & 63);
+    if ((d.present & bit) == 0) return nullptr;
+    return hashmaps + d.rank + __builtin_popcountll(d.present & (bit - 1));
+  }
+  // fill in rank for every directory word up to and including last
+  void rankDirectory(uint32_t last) {
+    for (uint32_t i = 0, r = 0; i <= last; i++) {
+      directory[i].rank = r;
+      r += __builtin_popcountll(directory[i].present);
+    }
+  }
+  static uint32_t align8(uint32_t v) { return (v + 7) & ~7U; }
+  uint64_t bufferSize() const {
+    return sizeof(Info) + textCapacity + directorySize +
+           uint64_t(mapCapacity) * sizeof(HashMap) +
+           uint64_t(nodeCapacity) * sizeof(HashMapNode);
+  }
+
+  // the build buffer, with room for every trigram. Only the used ones are saved
+  void allocate(uint64_t textSize, uint64_t nodeSize,
+                uint32_t maps = FIRST_N) {
+    if (textSize > UINT32_MAX - 7 || nodeSize > UINT32_MAX)
+      throw "TrieHashDict capacity exceeded";
+    nodeCapacity = nodeSize;
+    textCapacity = align8(textSize);
+    mapCapacity = maps;
+    text = new char[bufferSize()];
     pInfo = (Info *)text;
     text += sizeof(Info);
-    hashmaps = (HashMap *)(text + textSize);  // TODO: call constructors
-                                              // new HashMap[26*26*26];
-
-    nodes = (HashMapNode *)(text + textSize +
-                            hashMapOffset);  // new HashMapNode[nodeSize];
-    temp = nodes + info.numWords;
-    // TODO: initialize the arrays of hashmaps and hashmapnodes
+    directory = (DirectoryWord *)(text + textCapacity);
+    memset(directory, 0, directorySize);
+    hashmaps = (HashMap *)((char *)directory + directorySize);
+    nodes = (HashMapNode *)(hashmaps + mapCapacity);
+    memset(nodes, 0, uint64_t(nodeCapacity) * sizeof(HashMapNode));
+  }
+  // an empty dictionary to add() to, in a build buffer of these sizes
+  void startBuild(uint64_t textSize, uint64_t nodeSize) {
+    allocate(textSize, nodeSize);
     lastHashMap = -1;
     info.numWords = 1;
     info.numHashMaps = 0;
@@ -69,142 +241,1253 @@ class TrieHashDict {
     info.textSize = 1;
     startIndexOfCurrentHashMap = 0;
     wordsInCurrentHashMap = 0;
+    sealed = false;
+    rankSamples.push_back(0);  // for id 0, which is no word
+    samples = rankSamples.data();
+  }
+  // the table size add() ends up with for a hash map of words words
+  static uint32_t tableSlots(uint32_t words) {
+    uint32_t slots = 2;
+    while (slots < 2 * words) slots <<= 1;
+    return slots;
+  }
+  // run f(bin) for every prefix on threads threads, rethrowing any error
+  template <typename Func>
+  static void forEachBin(uint32_t threads, Func f) {
+    constexpr uint32_t STEP = 64;  // bins taken at a time
+    std::atomic<uint32_t> next(0);
+    std::atomic<const char *> error(nullptr);
+    auto work = [&] {
+      try {
+        for (uint32_t b; (b = next.fetch_add(STEP)) < FIRST_N;)
+          for (uint32_t i = b; i < std::min(b + STEP, FIRST_N); i++) f(i);
+      } catch (const char *msg) {
+        error = msg;
+        next = FIRST_N;
+      }
+    };
+    std::vector<std::thread> pool;
+    for (uint32_t t = 1; t < threads; t++) pool.emplace_back(work);
+    work();
+    for (std::thread &t : pool) t.join();
+    if (error != nullptr) throw error.load();
+  }
+
+  // point into the sections of the mapped file
+  void attach() {
+    uint64_t len;
+    const char *p = file.section(SECTION_INFO, len);
+    if (len != sizeof(Info)) throw "Dictionary file is corrupt";
+    info = *(const Info *)p;
+    if (alphabet.headerSize() != 0) {
+      p = file.section(SECTION_ALPHABET, len);
+      if (len != alphabet.headerSize()) throw "Dictionary file is corrupt";
+      alphabet.read(p);
+    }
+    text = (char *)file.section(SECTION_TEXT, len);
+    bool ok = len == info.textSize;
+    directory = (DirectoryWord *)file.section(SECTION_DIRECTORY, len);
+    ok &= len == directorySize;
+    hashmaps = (HashMap *)file.section(SECTION_HASHMAPS, len);
+    ok &= len == uint64_t(info.numHashMaps) * sizeof(HashMap);
+    nodes = (HashMapNode *)file.section(SECTION_NODES, len);
+    ok &= len == uint64_t(info.nodeSize) * sizeof(HashMapNode);
+    hot = (const HotEntry *)file.section(SECTION_HOT, len, false);
+    if (hot != nullptr) {
+      hotMask = len / sizeof(HotEntry) - 1;
+      ok &= len != 0 && len % sizeof(HotEntry) == 0 &&
+            (hotMask & (hotMask + 1)) == 0;
+    }
+    shorts = (const ShortWord *)file.section(SECTION_SHORT, len, false);
+    numShorts = len / sizeof(ShortWord);
+    if (shorts != nullptr) ok &= len % sizeof(ShortWord) == 0;
+    samples = (const Offset *)file.section(SECTION_RANK, len, false);
+    if (samples != nullptr) ok &= len == numSamples() * sizeof(Offset);
+    filter =
+        (const WordFilter::Block *)file.section(SECTION_FILTER, len, false);
+    if (filter != nullptr) {
+      filterBlocks = len / sizeof(WordFilter::Block);
+      ok &= len != 0 && len % sizeof(WordFilter::Block) == 0;
+    }
+    if (!ok) throw "Dictionary file is corrupt";
+    textCapacity = info.textSize;
+    nodeCapacity = info.nodeSize;
+    mapCapacity = info.numHashMaps;
+    findTextEnds();
+  }
+  // one past the last byte of text of h
+  uint32_t textEnd(const HashMap *h) const {
+    if (!textEnds.empty()) return textEnds[h - hashmaps];
+    return h + 1 < hashmaps + info.numHashMaps ? h[1].base + 2
+                                               : info.textSize;
+  }
+  // fill textEnds if the text of the hash maps is not in their order
+  void findTextEnds() {
+    textEnds.clear();
+    bool ordered = true;
+    for (uint32_t k = 1; k < info.numHashMaps; k++)
+      ordered &= hashmaps[k].base + 2 >= hashmaps[k - 1].base + 2;
+    if (ordered) return;
+    std::vector<uint32_t> byText(info.numHashMaps);
+    for (uint32_t k = 0; k < info.numHashMaps; k++) byText[k] = k;
+    std::sort(byText.begin(), byText.end(), [this](uint32_t a, uint32_t b) {
+      return hashmaps[a].base + 2 < hashmaps[b].base + 2;
+    });
+    textEnds.resize(info.numHashMaps);
+    for (uint32_t i = 0; i < byText.size(); i++)
+      textEnds[byText[i]] = i + 1 < byText.size()
+                                ? hashmaps[byText[i + 1]].base + 2
+                                : info.textSize;
+  }
+  // true if the nodes and text of h have been read, otherwise ask for them
+  bool mapLoaded(const HashMap *h) const {
+    const char *begin = text + (h->base + 2);  // offsets 0 and 1 are special
+    const char *end = text + textEnd(h);
+    uint64_t textAt = begin - loader->data(), textLen = end - begin;
+    uint64_t nodesAt = (const char *)(nodes + h->start) - loader->data();
+    uint64_t nodesLen = (h->size + 1) * sizeof(HashMapNode);
+    if (loader->ready(textAt, textLen) && loader->ready(nodesAt, nodesLen))
+      return true;
+    loader->demand(nodesAt, nodesLen);
+    loader->demand(textAt, textLen);
+    return false;
+  }
+  // look a whole word up in the hot table
+  bool getHot(const char word[], uint32_t len, uint32_t &id) const {
+    if (len > HOT_WORD) return false;
+    const HotEntry &e = hot[uint32_t(Hash::hash(word, len)) & hotMask];
+    if (e.len != len || memcmp(e.word, word, len) != 0) return false;
+    TRIEHASH_STAT(stats.hotHits++);
+    id = e.id;
+    return true;
+  }
+  // the alphabet codes of word, false if a byte is not in the alphabet
+  bool toCodes(const char word[], uint32_t len, uint8_t codes[]) const {
+    for (uint32_t i = 0; i < len; i++) {
+      int32_t c = alphabet.index(word[i]);
+      if (c < 0) return false;
+      codes[i] = c;
+    }
+    return true;
+  }
+  static bool lessCodes(const uint8_t a[], uint32_t alen, const uint8_t b[],
+                        uint32_t blen) {
+    return std::lexicographical_compare(a, a + alen, b, b + blen);
+  }
+  // the first short word not less than codes
+  const ShortWord *shortBound(const uint8_t codes[], uint32_t len) const {
+    return std::lower_bound(shorts, shorts + numShorts, len,
+                            [codes](const ShortWord &s, uint32_t len) {
+                              return lessCodes(s.codes, s.len, codes, len);
+                            });
+  }
+  bool getShort(const char word[], uint32_t len, uint32_t &id) const {
+    uint8_t codes[PrefixLen];
+    if (len == 0 || !toCodes(word, len, codes)) return false;
+    const ShortWord *s = shortBound(codes, len);
+    if (s == shorts + numShorts || s->len != len ||
+        memcmp(s->codes, codes, len) != 0)
+      return false;
+    id = s->id;
+    return true;
+  }
+  // the first id in the hash maps of prefix number which and after
+  uint32_t firstIdFrom(uint32_t which) const {
+    for (uint32_t d = which >> 6; d < DIRECTORY_WORDS; d++) {
+      uint64_t bits = directory[d].present;
+      if (d == which >> 6) bits &= ~0ULL << (which & 63);
+      if (bits != 0)
+        return hashmaps[directory[d].rank +
+                        __builtin_popcountll(directory[d].present &
+                                             ((bits & -bits) - 1))]
+            .baseid;
+    }
+    return info.numWords;
+  }
+  /*
+    The id of the first word not less than codes, or info.numWords if there
+    is none. Since ids are ranks, it is the smallest of: the first such
+    short word, the first such word in the hash map of codes' prefix, and
+    the first word of the next hash map.
+  */
+  uint32_t lowerBound(const uint8_t codes[], uint32_t len) const {
+    uint32_t best = info.numWords;
+    const ShortWord *s = shortBound(codes, len);
+    if (s != shorts + numShorts) best = s->id;
+    uint32_t which = 0;
+    for (uint32_t i = 0; i < PrefixLen; i++)
+      which = which * Alphabet::size + (i < len ? codes[i] : 0);
+    if (len >= PrefixLen) {
+      const HashMap *h = findHashMap(which);
+      if (h != nullptr) {
+        char target[256];
+        uint32_t n = len - PrefixLen;
+        for (uint32_t i = 0; i < n; i++)
+          target[i] = alphabet.textCode(alphabet.symbol(codes[PrefixLen + i]));
+        uint32_t end = mapEnd(h), id = boundInMap(h, end, target, n);
+        if (id < end) return std::min(best, id);
+      }
+      which++;  // every word of this prefix is less
+    }
+    return std::min(best, firstIdFrom(which));
+  }
+  void sample(Offset at) {
+    if (info.numWords % RANK_STEP != 0) return;
+    rankSamples.push_back(at);
+    samples = rankSamples.data();
+  }
+  uint32_t numSamples() const {
+    return (info.numWords + RANK_STEP - 1) / RANK_STEP;
+  }
+  // one past the last id of hash map h
+  uint32_t mapEnd(const HashMap *h) const {
+    uint32_t end = h + 1 < hashmaps + info.numHashMaps ? h[1].baseid
+                                                        : info.numWords;
+    const ShortWord *s = std::lower_bound(
+        shorts, shorts + numShorts, h->baseid,
+        [](const ShortWord &s, uint32_t id) { return s.id < id; });
+    return s != shorts + numShorts ? std::min(end, s->id) : end;
+  }
+  // true if the prefix of h is a word by itself
+  bool hasEmptySuffix(const HashMap *h) const {
+    for (uint32_t i = h->home("", 0);;
+         i = i < h->start + h->size ? i + 1 : h->start)
+      if (nodes[i].offset <= 1) return nodes[i].offset == 1;
+  }
+  // the suffix after the one at p in the text
+  static const char *nextSuffix(const char *p) {
+    while ((*p & 128) == 0) p++;
+    return p + 1;
+  }
+  // compare the suffix at p with target, both text codes, like strcmp
+  static int compareSuffix(const char *p, const char target[], uint32_t n) {
+    for (uint32_t k = 0;; k++) {
+      if (k == n) return 1;  // target is a proper prefix of the suffix
+      uint8_t c = p[k] & 127, t = target[k];
+      if (c != t) return c < t ? -1 : 1;
+      if (p[k] & 128) return k + 1 < n ? -1 : 0;
+    }
+  }
+  /*
+    The first id of h whose suffix is not less than target, or end. A binary
+    search over the samples of h finds the last one less than target, then
+    at most RANK_STEP suffixes after it are compared.
+  */
+  uint32_t boundInMap(const HashMap *h, uint32_t end, const char target[],
+                      uint32_t n) const {
+    if (samples == nullptr) throw "no rank samples in this dictionary";
+    uint32_t id = h->baseid;
+    const char *p = text + (h->base + 2);  // the suffixes start here
+    if (hasEmptySuffix(h)) {  // it comes first, and has no text
+      if (n == 0) return id;
+      id++;
+    }
+    uint32_t lo = (id + RANK_STEP - 1) / RANK_STEP,
+             hi = (end + RANK_STEP - 1) / RANK_STEP;
+    while (lo < hi) {
+      uint32_t mid = (lo + hi) / 2;
+      const char *q = text + (h->base + samples[mid]);
+      if (compareSuffix(q, target, n) < 0) {
+        id = mid * RANK_STEP;
+        p = q;
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    for (; id < end; id++, p = nextSuffix(p))
+      if (compareSuffix(p, target, n) >= 0) return id;
+    return end;
+  }
+  // the number of the prefix of hash map k
+  uint32_t mapPrefix(uint32_t k) const {
+    uint32_t d = 0;
+    for (uint32_t i = 0; i < DIRECTORY_WORDS; i++) {
+      if (directory[i].present == 0) continue;
+      if (directory[i].rank > k) break;
+      d = i;
+    }
+    uint64_t bits = directory[d].present;
+    for (uint32_t i = directory[d].rank; i < k; i++) bits &= bits - 1;
+    return d * 64 + __builtin_ctzll(bits);
+  }
+
+ public:
+  explicit BasicTrieHashDict(uint32_t expectedWords = 213000)
+      : loader(nullptr),
+        hot(nullptr),
+        hotMask(0),
+        filter(nullptr),
+        filterBlocks(0),
+        shorts(nullptr),
+        numShorts(0),
+        samples(nullptr) {
+    // tables are 25-50% full
+    startBuild(uint64_t(expectedWords) * 8, uint64_t(expectedWords) * 4);
+  }
+  /*
+    A build buffer that is sure to hold words words, when letters is at
+    least the letters they have after the prefix, so their total length
+    will do. Every table is at most 4 nodes per word, and growing the last
+    one needs 2 more for each of its words.
+  */
+  BasicTrieHashDict(uint64_t words, uint64_t letters)
+      : loader(nullptr),
+        hot(nullptr),
+        hotMask(0),
+        filter(nullptr),
+        filterBlocks(0),
+        shorts(nullptr),
+        numShorts(0),
+        samples(nullptr) {
+    startBuild(letters + 1 + 256, words * 6 + 2);
+  }
+  /*
+    fast load the TrieHashDict in binary. The file is mapped and used in
+    place, so a loaded dictionary is read only. Only the header and the
+    section bounds are checked here, call verify() to check the CRCs.
+  */
+  BasicTrieHashDict(const char filename[])
+      : pInfo(nullptr),
+        loader(nullptr),
+        hot(nullptr),
+        hotMask(0),
+        filter(nullptr),
+        filterBlocks(0),
+        shorts(nullptr),
+        numShorts(0),
+        samples(nullptr),
+        lastHashMap(-1),
+        startIndexOfCurrentHashMap(0),
+        wordsInCurrentHashMap(0),
+        sealed(false) {
+    file.open(filename, DICT_TRIEHASH, layout());
+    attach();
+  }
+  // use an image already in memory, which must outlive the dictionary
+  BasicTrieHashDict(const char buf[], uint64_t len)
+      : pInfo(nullptr),
+        loader(nullptr),
+        hot(nullptr),
+        hotMask(0),
+        filter(nullptr),
+        filterBlocks(0),
+        shorts(nullptr),
+        numShorts(0),
+        samples(nullptr),
+        lastHashMap(-1),
+        startIndexOfCurrentHashMap(0),
+        wordsInCurrentHashMap(0),
+        sealed(false) {
+    file.open(buf, len, DICT_TRIEHASH, layout());
+    attach();
+  }
+  /*
+    Serve a dictionary while loader is still reading it. This waits only for
+    the header and the small sections every lookup needs (the directory and
+    the hash maps); the text and nodes keep arriving in the background. Until
+    loader.done(), look words up with tryGet, which answers from the hash
+    maps already read and asks for the rest. loader must outlive the
+    dictionary.
+  */
+  explicit BasicTrieHashDict(AsyncLoader &loader)
+      : pInfo(nullptr),
+        loader(&loader),
+        hot(nullptr),
+        hotMask(0),
+        filter(nullptr),
+        filterBlocks(0),
+        shorts(nullptr),
+        numShorts(0),
+        samples(nullptr),
+        lastHashMap(-1),
+        startIndexOfCurrentHashMap(0),
+        wordsInCurrentHashMap(0),
+        sealed(false) {
+    loader.waitFor(0, sizeof(DictFile::FileHeader));
+    uint32_t numSections =
+        ((const DictFile::FileHeader *)loader.data())->numSections;
+    loader.waitFor(0, sizeof(DictFile::FileHeader) +
+                          uint64_t(numSections) *
+                              sizeof(DictFile::SectionEntry));
+    file.open(loader.data(), loader.fileSize(), DICT_TRIEHASH, layout());
+    const uint32_t needed[] = {SECTION_INFO, SECTION_ALPHABET,
+                               SECTION_DIRECTORY, SECTION_HASHMAPS,
+                               SECTION_HOT, SECTION_SHORT, SECTION_RANK,
+                               SECTION_FILTER};
+    for (uint32_t id : needed) {
+      uint64_t len;
+      const char *p = file.section(id, len, false);
+      if (p != nullptr) loader.demand(p - loader.data(), len);
+    }
+    for (uint32_t id : needed) {
+      uint64_t len;
+      const char *p = file.section(id, len, false);
+      if (p != nullptr) loader.waitFor(p - loader.data(), len);
+    }
+    attach();
+  }
+
+  // the template parameters, recorded in the file so a mismatch is caught
+  static constexpr uint64_t layout() {
+    return uint64_t(Alphabet::size) | uint64_t(Alphabet::remaps) << 8 |
+           uint64_t(PrefixLen) << 12 | uint64_t(sizeof(Offset)) << 16 |
+           uint64_t(sizeof(RelId)) << 20 | uint64_t(Hash::id) << 24 |
+           uint64_t(MaxBucket) << 32;
+  }
+  // check the CRC32C of every section, false if the file is damaged
+  bool verify() const { return !file.isOpen() || file.verifyAll(); }
+  ~BasicTrieHashDict() { delete[] pInfo; }
+  BasicTrieHashDict(const BasicTrieHashDict &orig) = delete;
+  BasicTrieHashDict &operator=(const BasicTrieHashDict &orig) = delete;
+
+  const Alphabet &getAlphabet() const { return alphabet; }
+  uint32_t numWords() const { return info.numWords - 1; }  // ids start at 1
+  // bytes of the sections written by save(), ie the size of the image
+  uint64_t imageSize() const {
+    return sizeof(Info) + alphabet.headerSize() + info.textSize +
+           directorySize + uint64_t(info.numHashMaps) * sizeof(HashMap) +
+           uint64_t(info.nodeSize) * sizeof(HashMapNode) + hotSize() +
+           uint64_t(numShorts) * sizeof(ShortWord) +
+           (samples == nullptr ? 0 : numSamples() * sizeof(Offset)) +
+           filterSize();
+  }
+  /*
+    Where the bytes of the dictionary go: each section save() writes, the
+    build buffer (0 for a loaded dictionary) and how many node slots are
+    empty. shrinkToFit() brings the buffer down to the sections in it.
+  */
+  struct Footprint {
+    uint64_t info, alphabet, text, directory, hashMaps, nodes;
+    uint64_t hot, shorts, rank, filter;
+    uint64_t buffer;  // allocated while building, with room for more words
+    uint64_t slots, emptySlots;
+    uint64_t image() const {
+      return info + alphabet + text + directory + hashMaps + nodes + hot +
+             shorts + rank + filter;
+    }
+    uint64_t emptySlotBytes() const {
+      return emptySlots * sizeof(HashMapNode);
+    }
+  };
+  Footprint footprint() const {
+    Footprint f;
+    f.info = sizeof(Info);
+    f.alphabet = alphabet.headerSize();
+    f.text = info.textSize;
+    f.directory = directorySize;
+    f.hashMaps = uint64_t(info.numHashMaps) * sizeof(HashMap);
+    f.nodes = uint64_t(info.nodeSize) * sizeof(HashMapNode);
+    f.hot = hotSize();
+    f.shorts = uint64_t(numShorts) * sizeof(ShortWord);
+    f.rank = samples == nullptr ? 0 : numSamples() * sizeof(Offset);
+    f.filter = filterSize();
+    f.buffer = pInfo == nullptr ? 0 : bufferSize();
+    f.slots = info.nodeSize;
+    f.emptySlots = 0;
+    for (uint32_t i = 0; i < info.nodeSize; i++)
+      f.emptySlots += nodes[i].offset == 0;
+    return f;
+  }
+  /*
+    Move a built dictionary into a buffer of exactly the size it uses,
+    giving back the room reserved for words that never came. add() throws
+    after. A loaded dictionary is exact already.
+  */
+  void shrinkToFit() {
+    if (pInfo == nullptr) return;
+    Info *old = pInfo;
+    const char *oldText = text;
+    const DirectoryWord *oldDirectory = directory;
+    const HashMap *oldMaps = hashmaps;
+    const HashMapNode *oldNodes = nodes;
+    allocate(info.textSize, info.nodeSize, info.numHashMaps);
+    memcpy(text, oldText, info.textSize);
+    memcpy(directory, oldDirectory, directorySize);
+    memcpy(hashmaps, oldMaps, uint64_t(info.numHashMaps) * sizeof(HashMap));
+    memcpy(nodes, oldNodes, uint64_t(info.nodeSize) * sizeof(HashMapNode));
+    delete[] old;
+    sealed = true;
+  }
+  // bytes of the filter, 0 if there is none
+  uint64_t filterSize() const {
+    return uint64_t(filterBlocks) * sizeof(WordFilter::Block);
+  }
+  // bytes of the hot table, 0 if there is none
+  uint64_t hotSize() const {
+    return hot == nullptr ? 0 : (uint64_t(hotMask) + 1) * sizeof(HotEntry);
   }
-  // fast load the TrieHashDict in binary
-  TrieHashDict(const char filename[]) {
-    int fh = open(filename, O_RDONLY);
-    struct stat st;
-    fstat(fh, &st);
-    uint32_t len = st.st_size;
-    pInfo = (Info *)new char[len];
-    int bytesRead = read(fh, (char *)pInfo, len);
-    if (bytesRead < len) {
-      throw "Could not read entire file";
-    }
-    info = *pInfo;
-    text = (char *)(pInfo + 1);
-    hashmaps = (HashMap *)(text + info.textSize);
-    nodes = (HashMapNode *)(text + info.textSize + hashMapOffset);
-  }
-  ~TrieHashDict() { delete[] pInfo; }
-  TrieHashDict(const TrieHashDict &orig) = delete;
-  TrieHashDict &operator=(const TrieHashDict &orig) = delete;
-
-  void save(const char filename[]) {
-    int fh = open(filename, O_WRONLY);
-    uint32_t len = sizeof(Info) + info.textSize + hashMapOffset +
-                   info.nodeSize * sizeof(HashMapNode);
-    // TODO: Make sure the bytes are right. currently preallocated capacity
-    // crunch the data structure before writing
-    write(fh, pInfo, len);
-    close(fh);
-  }
-  void checkGrow(uint32_t requested) {
-    // compare info.nodeSize > nodeCapacity
-    // TODO: CHeck if we need to get more Nodes
+  // a remapping alphabet must be set before the first word is added
+  void setAlphabet(const Alphabet &a) { alphabet = a; }
+
+  /*
+    The saved image is a DictFile with a section each for Info, the alphabet
+    table (none for Alpha26), the text, the directory, and only the hash
+    maps and nodes in use, so it is much smaller than the build buffer. The
+    hot table, if prioritize() made one, the short words, if there are any,
+    the rank samples and the filter go last. With filterBitsPerWord, a new
+    filter of that many bits per word is built first.
+   */
+  void save(const char filename[], uint32_t filterBitsPerWord = 0) {
+    if (filterBitsPerWord != 0) buildFilter(filterBitsPerWord);
+    DictFileWriter w(DICT_TRIEHASH, layout());
+    addSections(w);
+    w.write(filename);
+  }
+  /*
+    Add the sections of the image to w, for a file that carries more
+    sections of its own, like a MultiDict. They must stay valid until
+    w.write().
+  */
+  void addSections(DictFileWriter &w) {
+    if (!file.isOpen()) rankDirectory(DIRECTORY_WORDS - 1);
+    w.add(SECTION_INFO, &info, sizeof(Info));
+    if (alphabet.headerSize() != 0)
+      w.add(SECTION_ALPHABET, alphabet.header(), alphabet.headerSize());
+    w.add(SECTION_TEXT, text, info.textSize);
+    w.add(SECTION_DIRECTORY, directory, directorySize);
+    w.add(SECTION_HASHMAPS, hashmaps, info.numHashMaps * sizeof(HashMap));
+    w.add(SECTION_NODES, nodes, info.nodeSize * sizeof(HashMapNode));
+    if (hot != nullptr) w.add(SECTION_HOT, hot, hotSize());
+    if (numShorts != 0)
+      w.add(SECTION_SHORT, shorts, numShorts * sizeof(ShortWord));
+    if (samples != nullptr)
+      w.add(SECTION_RANK, samples, numSamples() * sizeof(Offset));
+    if (filter != nullptr) w.add(SECTION_FILTER, filter, filterSize());
+  }
+  // the mapped file of a loaded dictionary, for sections others added
+  const DictFileReader &image() const { return file; }
+  // throw if add() could not put a word with a suffix of suffixLen into the
+  // hash map of trigram which: a new map, its text, or growing its table
+  void checkRoom(int which, uint32_t suffixLen) const {
+    bool newMap = which != lastHashMap;
+    const HashMap *h = newMap ? nullptr : &hashmaps[info.numHashMaps - 1];
+    uint32_t words = newMap ? 0 : wordsInCurrentHashMap;
+    if (words >= MaxBucket) throw "bucket exceeds MaxBucket";
+    uint64_t start = newMap ? info.nodeSize : startIndexOfCurrentHashMap;
+    uint64_t size = newMap ? 1 : h->size;  // a new map starts with 2 slots
+    if (newMap && (info.numHashMaps == mapCapacity || start + 2 > nodeCapacity))
+      throw "TrieHashDict capacity exceeded";
+    uint32_t base = newMap ? info.textSize - 2 : h->base;
+    if (suffixLen != 0 &&
+        info.textSize - base > std::numeric_limits<Offset>::max())
+      throw "hash map text too big for Offset";
+    uint64_t textEnd = uint64_t(info.textSize) + suffixLen;
+    if (textEnd > textCapacity) throw "TrieHashDict capacity exceeded";
+    if ((words + 1) * 2 > size + 1) {
+      // the doubled table and the scratch copy of the old one must both fit
+      uint64_t grown = (size + 1) * 2;
+      if (start + grown + size + 1 > nodeCapacity ||
+          textEnd + 256 > textCapacity)
+        throw "TrieHashDict capacity exceeded";
+    }
   }
+  // how many words from start on share the prefix of the first one
   uint32_t countWordsWithSamePrefix(const uint8_t buf[], uint32_t start,
                                     uint32_t size) {
-    uint32_t last = 100000;  // the first time, there is no last prefix, so set
-                             // a value that cannot possible be equal
+    Tokenizer<NON_SPACE> tok((const char *)buf + start, size - start);
+    int32_t first = -1;
     uint32_t countWords = 0;
-    for (uint32_t i = start; i < size;) {
-      uint8_t c1 = buf[i++];
-      if (c1 < 'a' || c1 > 'z') goto nextWord;
-      uint8_t c2 = buf[i++];
-      if (c2 < 'a' || c2 > 'z') goto nextWord;
-      uint8_t c3 = buf[i++];
-      if (c3 < 'a' || c3 > 'z') goto nextWord;
-      uint32_t which = (c1 * 26 + c2) * 26 + c3;
-      if (which != last) {
-        if (last == 100000) {  // first time
-          countWords = 1;
-          last = which;
-        } else
-          return countWords;
-      } else {
-        countWords++;
-      }
-    nextWord:
-      while (buf[i] >= 'a' && buf[i] <= 'z') i++;  // skip to end of word
-      while (buf[i] < ' ') i++;                    // skip any spaces
+    for (Tokenizer<NON_SPACE>::Span w; tok.next(w);) {
+      if (w.len < PrefixLen) continue;
+      int32_t which = whichHash((const char *)buf + start + w.start);
+      if (which < 0) continue;
+      if (first < 0) first = which;
+      if (which != first) break;
+      countWords++;
     }
     return countWords;
   }
 
   void load(const char filename[]) {
-    ifstream f(filename, ios::binary | ios::ate);
-    streamsize size = f.tellg();
+    std::ifstream f(filename, std::ios::binary | std::ios::ate);
+    std::streamsize size = f.tellg();
     f.seekg(0, std::ios::beg);
     char *buf = new char[size];
     if (!f.read(buf, size)) throw "Error, can't load file";
-    uint32_t last = 100000;  // last does not exist the first time
-    for (uint32_t i = 0; i < size; i++) {
-      while (i < size && buf[i] <= ' ') i++;  // skip space
-      uint32_t hashSize = countWordsWithSamePrefix(buf, i, size);
-      for (uint32_t j = 0; j < hashSize; j++) {
-        uint32_t k;
-        for (k = j + 1; k < hashSize && buf[k] > 'a'; k++)
-          ;
-        add(buf + i, k - i);
-      }
+    Tokenizer<NON_SPACE> tok(buf, size);
+    Tokenizer<NON_SPACE>::Span w;
+    if constexpr (!Alphabet::remaps) {
+      while (tok.next(w)) add(buf + w.start, w.len);
+    } else {
+      // rank the symbols of this dictionary, then add the words in code order
+      alphabet.build(buf, size);
+      std::vector<Tokenizer<NON_SPACE>::Span> words;
+      while (tok.next(w)) words.push_back(w);
+      std::sort(words.begin(), words.end(),
+                [this, buf](const Tokenizer<NON_SPACE>::Span &a,
+                            const Tokenizer<NON_SPACE>::Span &b) {
+                  return std::lexicographical_compare(
+                      buf + a.start, buf + a.start + a.len, buf + b.start,
+                      buf + b.start + b.len, [this](char x, char y) {
+                        return alphabet.index(x) < alphabet.index(y);
+                      });
+                });
+      for (auto &w : words) add(buf + w.start, w.len);
     }
     delete[] buf;
   }
 
+  /*
+    Build from a source whose words come in bins, one per prefix, that can
+    be decoded independently, like CompressedDictReader. The bins are shared
+    out among threads twice. The first pass counts the words and text of
+    each bin, then a prefix sum over the counts places every hash map. The
+    second pass decodes again and writes the text and nodes of each bin
+    into its own part of the image, so nothing is shared. Ids come out the
+    same as adding the words in order. The dictionary must be empty, and
+    add() throws after.
+
+    Source has FIRST_N, prefixLen, getAlphabet() and forEachSuffix(bin, f),
+    which calls f(const uint8_t codes[], uint32_t len) for each word.
+  */
+  template <typename Source>
+  void loadBins(const Source &src, uint32_t threads = 0) {
+    static_assert(Source::FIRST_N == FIRST_N && Source::prefixLen == PrefixLen,
+                  "the source must be binned by the same prefixes");
+    if (numWords() != 0) throw "loadBins needs an empty dictionary";
+    if (threads == 0)
+      threads = std::max(1U, std::thread::hardware_concurrency());
+    alphabet = src.getAlphabet();
+    struct Bin {
+      uint32_t words;
+      uint32_t text;
+      uint32_t lastStart;  // where the text of the last word starts
+    };
+    std::vector<Bin> bins(FIRST_N);
+    forEachBin(threads, [&src, &bins](uint32_t i) {
+      Bin b = {0, 0, 0};
+      src.forEachSuffix(i, [&b](const uint8_t *, uint32_t len) {
+        if (len != 0) b.lastStart = b.text;
+        b.text += len;
+        b.words++;
+      });
+      bins[i] = b;
+    });
+
+    uint64_t textSize = 1, nodeSize = 0;  // text starts at 1 as in add()
+    for (const Bin &b : bins) {
+      if (b.words == 0) continue;
+      if (b.words > MaxBucket) throw "bucket exceeds MaxBucket";
+      if (b.lastStart + 2 > std::numeric_limits<Offset>::max())
+        throw "hash map text too big for Offset";
+      textSize += b.text;
+      nodeSize += tableSlots(b.words);
+    }
+    if (textSize + 256 > UINT32_MAX || nodeSize > UINT32_MAX)
+      throw "TrieHashDict capacity exceeded";
+    delete[] pInfo;
+    allocate(textSize + 256, nodeSize);
+    uint32_t textAt = 1, nodeAt = 0;
+    for (uint32_t i = 0; i < FIRST_N; i++) {
+      if (bins[i].words == 0) continue;
+      directory[i >> 6].present |= 1ULL << (i & 63);
+      HashMap &h = hashmaps[info.numHashMaps++];
+      h.base = textAt - 2;  // 0 is null, 1 is special value empty string
+      h.baseid = info.numWords;
+      h.start = nodeAt;
+      h.size = tableSlots(bins[i].words) - 1;
+      textAt += bins[i].text;
+      nodeAt += h.size + 1;
+      info.numWords += bins[i].words;
+      lastHashMap = i;
+      startIndexOfCurrentHashMap = h.start;
+      wordsInCurrentHashMap = bins[i].words;
+    }
+    info.textSize = textAt;
+    info.nodeSize = nodeAt;
+    rankDirectory(DIRECTORY_WORDS - 1);
+    rankSamples.assign(numSamples(), 0);
+    samples = rankSamples.data();
+
+    forEachBin(threads, [this, &src, &bins](uint32_t i) {
+      if (bins[i].words == 0) return;
+      const HashMap &h = *findHashMap(i);
+      uint32_t at = h.base + 2, relid = 0;
+      src.forEachSuffix(i, [&](const uint8_t codes[], uint32_t len) {
+        char *p = text + at;
+        for (uint32_t k = 0; k < len; k++)
+          p[k] = alphabet.textCode(alphabet.symbol(codes[k]));
+        uint32_t slot = h.home(p, len);
+        while (nodes[slot].offset != 0)
+          slot = slot < h.start + h.size ? slot + 1 : h.start;
+        if (len == 0) {
+          nodes[slot].offset = 1;
+        } else {
+          nodes[slot].offset = at - h.base;
+          p[len - 1] |= 128;
+          at += len;
+        }
+        if ((h.baseid + relid) % RANK_STEP == 0)
+          rankSamples[(h.baseid + relid) / RANK_STEP] = nodes[slot].offset;
+        nodes[slot].relid = relid++;
+      });
+    });
+    sealed = true;  // the image has no room to spare
+  }
+
+  /*
+    Build a blocked Bloom filter of every word at bitsPerWord bits per word
+    (10 lets about 1% of misses through). It is checked by every lookup
+    that reaches the directory, and dropped by add(). A loaded dictionary
+    can have one too; it lives in memory until the next save(). Misses
+    mostly end at the filter, but every hit pays for its hash and line, so
+    it is for traffic that is mostly misses, like spell checking.
+  */
+  void buildFilter(uint32_t bitsPerWord = 10) {
+    filterTable.assign(WordFilter::blocksFor(numWords(), bitsPerWord),
+                       WordFilter::Block());
+    filterBlocks = filterTable.size();
+    forEachWord([this](const char word[], uint32_t len) {
+      WordFilter::add(filterTable.data(), filterBlocks, word, len);
+    });
+    filter = filterTable.data();
+  }
+  void dropFilter() {
+    filter = nullptr;
+    filterBlocks = 0;
+    std::vector<WordFilter::Block>().swap(filterTable);
+  }
+  // false if the filter rules word out, true if it may be in (or no filter)
+  bool mayContain(const char word[], uint32_t len) const {
+    return filter == nullptr ||
+           WordFilter::mayContain(filter, filterBlocks, word, len);
+  }
+
+  // call f(const char word[], uint32_t len) for every word, in no order
+  template <typename Func>
+  void forEachWord(Func f) const {
+    char word[MAX_WORD];
+    for (uint32_t i = 0; i < numShorts; i++) {
+      for (uint32_t j = 0; j < shorts[i].len; j++)
+        word[j] = alphabet.symbol(shorts[i].codes[j]);
+      f((const char *)word, uint32_t(shorts[i].len));
+    }
+    uint32_t k = 0;
+    for (uint32_t d = 0; d < DIRECTORY_WORDS; d++)
+      for (uint64_t bits = directory[d].present; bits != 0; bits &= bits - 1) {
+        const HashMap &h = hashmaps[k++];
+        prefixString(d * 64 + __builtin_ctzll(bits), word);
+        for (uint32_t i = h.start; i <= h.start + h.size; i++) {
+          if (nodes[i].offset == 0) continue;
+          uint32_t len = h.suffixAt(*this, nodes[i], word + PrefixLen);
+          for (uint32_t j = PrefixLen; j < PrefixLen + len; j++)
+            word[j] = alphabet.fromText(word[j]);
+          f((const char *)word, PrefixLen + len);
+        }
+      }
+  }
+
+  /*
+    Lay out the nodes of every hash map again by how often each word is
+    looked up, weight(const char word[], uint32_t len) returning a count for
+    the whole word. Within a hash map the words are reinserted heaviest
+    first, so each one probes past only heavier words, and the heaviest
+    word of a hash map is always in its home slot. Ids and text do not
+    change. Then the hotEntries heaviest words of at most HOT_WORD bytes
+    (that do not collide with a heavier one) fill the hot table, none if
+    hotEntries is 0. Words of weight 0 never go in the hot table. The hot
+    table costs every lookup a hash of the whole word and one line, which
+    only pays when the traffic is skewed; for uniform traffic reorder alone.
+  */
+  template <typename Weight>
+  void prioritize(Weight weight, uint32_t hotEntries = 1024) {
+    if (file.isOpen()) throw "a loaded dictionary is read only";
+    if ((hotEntries & (hotEntries - 1)) != 0)
+      throw "hotEntries must be a power of 2";
+    struct Weighted {
+      uint64_t weight;
+      HashMapNode n;
+    };
+    struct HotWord {
+      uint64_t weight;
+      HotEntry e;
+    };
+    std::vector<Weighted> ws;
+    std::vector<HotWord> hots;
+    char word[PrefixLen + 256], suffix[256];
+    uint32_t k = 0;
+    for (uint32_t d = 0; d < DIRECTORY_WORDS; d++)
+      for (uint64_t bits = directory[d].present; bits != 0; bits &= bits - 1) {
+        const HashMap &h = hashmaps[k++];
+        prefixString(d * 64 + __builtin_ctzll(bits), word);
+        ws.clear();
+        for (uint32_t i = h.start; i <= h.start + h.size; i++) {
+          if (nodes[i].offset == 0) continue;
+          uint32_t len = h.suffixAt(*this, nodes[i], suffix);
+          for (uint32_t j = 0; j < len; j++)
+            word[PrefixLen + j] = alphabet.fromText(suffix[j]);
+          len += PrefixLen;
+          Weighted w = {weight((const char *)word, len), nodes[i]};
+          ws.push_back(w);
+          if (w.weight != 0 && len <= HOT_WORD && hotEntries != 0) {
+            HotWord hw = {w.weight, {h.baseid + w.n.relid, uint8_t(len), {}}};
+            memcpy(hw.e.word, word, len);
+            hots.push_back(hw);
+          }
+          nodes[i].offset = 0;
+        }
+        std::sort(ws.begin(), ws.end(),
+                  [](const Weighted &a, const Weighted &b) {
+                    return a.weight != b.weight ? a.weight > b.weight
+                                                : a.n.relid < b.n.relid;
+                  });
+        for (const Weighted &w : ws) {
+          uint32_t slot = h.home(suffix, h.suffixAt(*this, w.n, suffix));
+          while (nodes[slot].offset != 0)
+            slot = slot < h.start + h.size ? slot + 1 : h.start;
+          nodes[slot] = w.n;
+        }
+      }
+
+    hotTable.assign(hotEntries, HotEntry());
+    std::sort(hots.begin(), hots.end(), [](const HotWord &a, const HotWord &b) {
+      return a.weight != b.weight ? a.weight > b.weight : a.e.id < b.e.id;
+    });
+    for (const HotWord &hw : hots) {
+      HotEntry &e = hotTable[uint32_t(Hash::hash(hw.e.word, hw.e.len)) &
+                             (hotEntries - 1)];
+      if (e.id == 0) e = hw.e;
+    }
+    hot = hotEntries == 0 ? nullptr : hotTable.data();
+    hotMask = hotEntries - 1;
+  }
+  /*
+    prioritize by a file of lines of a word and its count. Words not in the
+    file weigh 0 and keep their order behind the ones that are.
+  */
+  void loadFrequencies(const char filename[], uint32_t hotEntries = 1024) {
+    std::ifstream f(filename);
+    if (!f) throw "Could not open frequency file";
+    std::unordered_map<std::string, uint64_t> counts;
+    std::string w;
+    uint64_t n;
+    while (f >> w >> n) counts[w] += n;
+    if (!f.eof()) throw "frequency file must be lines of word count";
+    prioritize(
+        [&counts](const char word[], uint32_t len) -> uint64_t {
+          auto it = counts.find(std::string(word, len));
+          return it == counts.end() ? 0 : it->second;
+        },
+        hotEntries);
+  }
+
+  /*
+    Move the nodes and text of the hash maps so the ones with the most
+    weight come first, weight[k] for hash map k (see trace), the rest
+    keeping their order after them. The hot part of the dictionary is then
+    the start of the text and node sections, a few pages (or huge pages)
+    that stay resident while the cold rest can stay on disk, and an
+    AsyncLoader reads it first. Lookups, ids and every other section are
+    the same. Works on a loaded dictionary too, copying it into memory to
+    save(). add() throws after.
+  */
+  void relayout(const std::vector<uint64_t> &weight) {
+    if (weight.size() != info.numHashMaps)
+      throw "relayout needs a weight for every hash map";
+    std::vector<uint32_t> order(info.numHashMaps);
+    for (uint32_t k = 0; k < info.numHashMaps; k++) order[k] = k;
+    std::stable_sort(order.begin(), order.end(),
+                     [&weight](uint32_t a, uint32_t b) {
+                       return weight[a] > weight[b];
+                     });
+    Info *old = pInfo;
+    const char *oldText = text;
+    const DirectoryWord *oldDirectory = directory;
+    const HashMap *oldMaps = hashmaps;
+    const HashMapNode *oldNodes = nodes;
+    std::vector<uint32_t> oldEnds(info.numHashMaps);
+    for (uint32_t k = 0; k < info.numHashMaps; k++)
+      oldEnds[k] = textEnd(oldMaps + k);
+    allocate(info.textSize, info.nodeSize, info.numHashMaps);
+    memcpy(directory, oldDirectory, directorySize);
+    memcpy(hashmaps, oldMaps, uint64_t(info.numHashMaps) * sizeof(HashMap));
+    // text before the first hash map's, if any, stays where it is
+    uint32_t textAt = info.numHashMaps == 0 ? info.textSize
+                                            : oldMaps[0].base + 2;
+    for (uint32_t k = 1; k < info.numHashMaps; k++)
+      textAt = std::min(textAt, oldMaps[k].base + 2);
+    memcpy(text, oldText, textAt);
+    uint32_t nodeAt = 0;
+    for (uint32_t k : order) {
+      HashMap &h = hashmaps[k];
+      uint32_t from = oldMaps[k].base + 2, n = oldEnds[k] - from;
+      memcpy(text + textAt, oldText + from, n);
+      h.base = textAt - 2;
+      textAt += n;
+      memcpy(nodes + nodeAt, oldNodes + oldMaps[k].start,
+             uint64_t(h.size + 1) * sizeof(HashMapNode));
+      h.start = nodeAt;
+      nodeAt += h.size + 1;
+    }
+    if (textAt != info.textSize || nodeAt > info.nodeSize)
+      throw "Dictionary file is corrupt";
+    info.nodeSize = nodeAt;
+    delete[] old;
+    findTextEnds();
+    sealed = true;  // the last hash map's text is no longer at the end
+  }
+
   void add(const char word[], uint32_t len) {
-    if (len <= 2) {
-      return;  // go into trie and set flag
+    uint8_t codes[PrefixLen + 256];
+    if (file.isOpen()) throw "a loaded dictionary is read only";
+    if (sealed) throw "no more words can be added to this dictionary";
+    if (len == 0) return;
+    if (len > PrefixLen + 256) throw "word too long";
+    if (!toCodes(word, len, codes)) throw "bad char";
+    if (!lessCodes((const uint8_t *)lastWord.data(), lastWord.size(), codes,
+                   len))
+      throw "words must be added in sorted order, without repeats";
+    // every check comes before the first change, so a word that is refused
+    // leaves the dictionary as it was
+    int which = -1;
+    char buf[256];
+    const char *suffix = nullptr;
+    if (len >= PrefixLen) {
+      which = whichHash(word);
+      suffix = encodeSuffix(word + PrefixLen, len - PrefixLen, buf);
+      if (which < 0 || suffix == nullptr) throw "bad char";
+      // the directory is built by appending, so trigrams must arrive in order
+      if (which < lastHashMap) throw "words must be added in sorted order";
+      checkRoom(which, len - PrefixLen);
     }
-    if (word[0] < 'a' || word[0] > 'z' || word[1] < 'a' || word[1] > 'z' ||
-        word[2] < 'a' || word[2] > 'z') {
-      throw "bad char";
+    lastWord.assign((const char *)codes, len);
+    dropFilter();  // it would not know the new word
+    if (len < PrefixLen) {
+      sample(0);
+      ShortWord w = {info.numWords++, uint8_t(len), {}};
+      memcpy(w.codes, codes, len);
+      shortWords.push_back(w);
+      shorts = shortWords.data();
+      numShorts = shortWords.size();
+      return;
     }
-    // ax^2 + bx + c   a*x*x + b*x + c  HORNER's FORM = (a*x+b)*x + c
-    int which = whichHash(word);
     if (which != lastHashMap) {
+      uint32_t first = lastHashMap < 0 ? 0 : (lastHashMap >> 6) + 1;
+      for (uint32_t i = first; i <= uint32_t(which >> 6); i++)
+        if (directory[i].present == 0) directory[i].rank = info.numHashMaps;
+      directory[which >> 6].present |= 1ULL << (which & 63);
       lastHashMap = which;
       wordsInCurrentHashMap = 0;
       startIndexOfCurrentHashMap = info.nodeSize;
-      // Now count how many words start with the same 3 letters
-      // so we can preallocate the right size hash map and not have to grow
+      HashMap &h = hashmaps[info.numHashMaps++];
+      h.base = info.textSize - 2;  // 0 is null, 1 is special value empty string
+      h.baseid = info.numWords;
+      h.start = info.nodeSize;
+      h.size = 1;  // power of 2 -1
+      info.nodeSize = h.start + h.size + 1;
+    }
+    hashmaps[info.numHashMaps - 1].add(*this, suffix, len - PrefixLen);
+  }
+
+  enum LookupResult { NOT_FOUND = 0, FOUND = 1, NOT_LOADED = 2 };
+  /*
+    get for a dictionary still being read by an AsyncLoader: NOT_LOADED if
+    the word's hash map has not arrived yet, in which case it is read next.
+    Once the load is done this is get.
+  */
+  LookupResult tryGet(const char word[], uint32_t len, uint32_t &id) const {
+    if (loader != nullptr && !loader->done() && len >= PrefixLen) {
+      int32_t which = whichHash(word);
+      const HashMap *h = which < 0 ? nullptr : findHashMap(which);
+      if (h != nullptr && !mapLoaded(h)) return NOT_LOADED;
+    }
+    return get(word, len, id) ? FOUND : NOT_FOUND;
+  }
 
-      hashmaps[which].base =
-          info.textSize - 2;  // 0 is null, 1 is special value empty string
-      hashmaps[which].baseid = info.nodeSize;
-      hashmaps[which].size = 1;  // power of 2 -1
-      info.nodeSize = hashmaps[which].baseid + hashmaps[which].size + 1;
+  bool get(const char word[], uint32_t len, uint32_t &id) const {
+    if (len < PrefixLen) return getShort(word, len, id);
+    if (hot != nullptr && getHot(word, len, id)) return true;
+    if (filter != nullptr &&
+        !WordFilter::mayContain(filter, filterBlocks, word, len)) {
+      TRIEHASH_STAT(stats.filterRejects++);
+      return false;
     }
-    hashmaps[which].add(*this, word + 3, len - 3);
+    int32_t which = whichHash(word);
+    if (which < 0) return false;
+    const HashMap *h = findHashMap(which);
+    if (h == nullptr) {
+      TRIEHASH_STAT(stats.directoryMisses++);
+      return false;
+    }
+    char buf[256];
+    const char *suffix = encodeSuffix(word + PrefixLen, len - PrefixLen, buf);
+    return suffix != nullptr && h->get(*this, suffix, len - PrefixLen, id);
+  }
+
+  /*
+    Look word up as get() does, calling touch(const void *p, uint32_t bytes)
+    for every node and every run of text it reads, to see which parts of
+    the image a query log uses. Returns the number of the hash map searched
+    (0 to numHashMaps() - 1), or -1 if the lookup reads none: a short word,
+    a hot word, one the filter turns away or one with no hash map.
+  */
+  template <typename Touch>
+  int32_t trace(const char word[], uint32_t len, Touch touch) const {
+    uint32_t id;
+    if (len < PrefixLen || (hot != nullptr && getHot(word, len, id)) ||
+        (filter != nullptr &&
+         !WordFilter::mayContain(filter, filterBlocks, word, len)))
+      return -1;
+    int32_t which = whichHash(word);
+    const HashMap *h = which < 0 ? nullptr : findHashMap(which);
+    char buf[256];
+    const char *suffix = encodeSuffix(word + PrefixLen, len - PrefixLen, buf);
+    if (h == nullptr || suffix == nullptr) return -1;
+    h->get(*this, suffix, len - PrefixLen, id, touch);
+    return h - hashmaps;
   }
+  uint32_t numHashMaps() const { return info.numHashMaps; }
 
-  bool get(const char word[], uint32_t len, uint32_t &id) {
-    int which = whichHash(word);
-    return hashmaps[which].get(word + 3, len - 3, id);
+#ifdef TRIEHASH_COROUTINES
+  /*
+    get() as a coroutine, for a CoroTask on a CoroScheduler (see
+    CoroLookup.hh): co_await dict.getAsync(word, len) gives the id of word,
+    or 0 if it is not in the dictionary. Before reading the hash map, the
+    home node and the text of each suffix it compares, the lookup
+    prefetches the line and lets the other tasks run. Words in the hot
+    table, short words and filter rejects are answered at once. word must
+    stay valid until the lookup returns.
+  */
+  CoroTask<uint32_t> getAsync(const char word[], uint32_t len) const {
+    uint32_t id = 0;
+    if (len < PrefixLen) co_return getShort(word, len, id) ? id : 0;
+    if (hot != nullptr && getHot(word, len, id)) co_return id;
+    if (filter != nullptr &&
+        !WordFilter::mayContain(filter, filterBlocks, word, len))
+      co_return 0;
+    int32_t which = whichHash(word);
+    const HashMap *h = which < 0 ? nullptr : findHashMap(which);
+    if (h == nullptr) co_return 0;
+    co_await CoroPrefetch{h};
+    char buf[256];
+    uint32_t n = len - PrefixLen;
+    const char *suffix = encodeSuffix(word + PrefixLen, n, buf);
+    if (suffix == nullptr) co_return 0;
+    uint32_t slot = h->home(suffix, n);
+    co_await CoroPrefetch{nodes + slot};
+    for (;; slot = slot < h->start + h->size ? slot + 1 : h->start) {
+      const HashMapNode &node = nodes[slot];
+      if (node.offset == 0) co_return 0;
+      if (node.offset == 1) {  // the empty suffix
+        if (n == 0) co_return h->baseid + node.relid;
+        continue;
+      }
+      if (n == 0) continue;
+      const char *p = text + (h->base + node.offset);
+      co_await CoroPrefetch{p};
+      uint32_t i = 0;
+      while (i < n - 1 && p[i] == suffix[i] && (p[i] & 128) == 0) i++;
+      if (i == n - 1 && p[i] == char(suffix[i] | 128) &&
+          (suffix[i] & 128) == 0)
+        co_return h->baseid + node.relid;
+    }
   }
+#endif
 
-  uint32_t *get(const char word[], uint32_t len) {
-    int which = whichHash(word);
-    return nullptr;  // TODO: IMPLEMENT
+  /*
+    Look up n words at once, setting ids[i] to the id of words[i], or 0 if it
+    is not in the dictionary (0 is never an id). The words go through in
+    groups. First the HashMap of every word in the group is found and
+    prefetched, then each word's home node is prefetched, and only then are
+    the words compared. The cache misses of a group overlap instead of being
+    paid one after another. Words in the hot table are answered in the first
+    pass, and words the filter rules out go no further. Returns the number
+    of words found.
+  */
+  uint32_t getBatch(const char *const words[], const uint32_t lens[],
+                    uint32_t n, uint32_t ids[]) const {
+    constexpr uint32_t GROUP = 16;
+    const HashMap *maps[GROUP];
+    const char *suffixes[GROUP];
+    char bufs[Alphabet::remaps ? GROUP : 1][256];
+    uint32_t found = 0;
+    for (uint32_t g = 0; g < n; g += GROUP) {
+      uint32_t m = std::min(GROUP, n - g);
+      for (uint32_t i = 0; i < m; i++) {
+        maps[i] = nullptr;
+        ids[g + i] = 0;
+        if (lens[g + i] < PrefixLen) {
+          found += getShort(words[g + i], lens[g + i], ids[g + i]);
+          continue;
+        }
+        if (hot != nullptr && getHot(words[g + i], lens[g + i], ids[g + i])) {
+          found++;
+          continue;
+        }
+        if (filter != nullptr &&
+            !WordFilter::mayContain(filter, filterBlocks, words[g + i],
+                                    lens[g + i])) {
+          TRIEHASH_STAT(stats.filterRejects++);
+          continue;
+        }
+        int32_t which = whichHash(words[g + i]);
+        if (which < 0) continue;
+        maps[i] = findHashMap(which);
+        if (maps[i] != nullptr) __builtin_prefetch(maps[i]);
+      }
+      for (uint32_t i = 0; i < m; i++) {
+        if (maps[i] == nullptr) continue;
+        uint32_t len = lens[g + i] - PrefixLen;
+        suffixes[i] = encodeSuffix(words[g + i] + PrefixLen, len,
+                                   bufs[Alphabet::remaps ? i : 0]);
+        if (suffixes[i] == nullptr)
+          maps[i] = nullptr;
+        else
+          __builtin_prefetch(nodes + maps[i]->home(suffixes[i], len));
+      }
+      for (uint32_t i = 0; i < m; i++) {
+        if (maps[i] != nullptr &&
+            maps[i]->get(*this, suffixes[i], lens[g + i] - PrefixLen,
+                         ids[g + i]))
+          found++;
+      }
+    }
+    return found;
+  }
+
+  // the longest word select can write
+  static constexpr uint32_t MAX_WORD = PrefixLen + 256;
+
+  /*
+    The number of words in the dictionary less than word, so id - 1 for a
+    word that is in it. Throws if a byte of word is not in the alphabet.
+    This and the two below need the whole image, so not while an
+    AsyncLoader is still reading it.
+  */
+  uint32_t rank(const char word[], uint32_t len) const {
+    uint8_t codes[MAX_WORD];
+    if (len > MAX_WORD || !toCodes(word, len, codes))
+      throw "letter not within alphabet";
+    return lowerBound(codes, len) - 1;
+  }
+
+  /*
+    Write the word with this id to word, which has room for MAX_WORD bytes,
+    and return its length, or 0 if no word has the id. The hash map of the
+    id is found by binary search on the first ids, and the suffix by
+    stepping through the text from the sample before it.
+  */
+  uint32_t select(uint32_t id, char word[]) const {
+    if (id == 0 || id >= info.numWords) return 0;
+    const ShortWord *s = std::lower_bound(
+        shorts, shorts + numShorts, id,
+        [](const ShortWord &s, uint32_t id) { return s.id < id; });
+    if (s != shorts + numShorts && s->id == id) {
+      for (uint32_t i = 0; i < s->len; i++)
+        word[i] = alphabet.symbol(s->codes[i]);
+      return s->len;
+    }
+    const HashMap *h =
+        std::upper_bound(hashmaps, hashmaps + info.numHashMaps, id,
+                         [](uint32_t id, const HashMap &h) {
+                           return id < h.baseid;
+                         }) -
+        1;
+    if (h < hashmaps) return 0;
+    if (samples == nullptr) throw "no rank samples in this dictionary";
+    prefixString(mapPrefix(h - hashmaps), word);
+    const char *p = text + (h->base + 2);  // the suffixes start here
+    uint32_t skip, from = id / RANK_STEP * RANK_STEP;
+    if (from >= h->baseid) {  // start from the sample
+      Offset at = samples[id / RANK_STEP];
+      if (at == 1) {  // the empty suffix
+        if (from == id) return PrefixLen;
+        skip = id - from - 1;
+      } else {
+        p = text + (h->base + at);
+        skip = id - from;
+      }
+    } else {
+      bool empty = hasEmptySuffix(h);
+      if (empty && id == h->baseid) return PrefixLen;
+      skip = id - h->baseid - empty;
+    }
+    while (skip-- > 0) p = nextSuffix(p);
+    uint32_t len = PrefixLen;
+    do {
+      word[len] = alphabet.fromText(*p & 127);
+      len++;
+    } while ((*p++ & 128) == 0);
+    return len;
+  }
+
+  /*
+    The ids [first, last) of the words that start with prefix, empty if
+    there are none. The end is the first word not less than the next
+    prefix, the last letter of prefix increased (carrying into the one
+    before if it is the last letter of the alphabet).
+  */
+  std::pair<uint32_t, uint32_t> prefixToIdRange(const char prefix[],
+                                                uint32_t len) const {
+    uint8_t codes[MAX_WORD];
+    if (len > MAX_WORD || !toCodes(prefix, len, codes))
+      throw "letter not within alphabet";
+    uint32_t first = lowerBound(codes, len);
+    while (len > 0 && codes[len - 1] == Alphabet::size - 1) len--;
+    if (len == 0) return std::make_pair(first, info.numWords);
+    codes[len - 1]++;
+    return std::make_pair(first, lowerBound(codes, len));
+  }
+
+#ifdef TRIEHASH_STATS
+  const LookupStats &getStats() const { return stats; }
+  void clearStats() { stats.clear(); }
+#endif
+
+  // the letters of prefix number which, PrefixLen of them
+  void prefixString(uint32_t which, char prefix[PrefixLen]) const {
+    for (uint32_t i = PrefixLen; i-- > 0; which /= Alphabet::size)
+      prefix[i] = alphabet.symbol(which % Alphabet::size);
+  }
+
+  /*
+    The shape of one hash map, computed from the image so it works on any
+    saved dictionary whether or not the counters are compiled in. A probe is
+    one node looked at. Each word is found once, and a miss is counted as
+    starting once at every slot.
+  */
+  struct BucketStats {
+    uint32_t prefix;      // number of the prefix, see prefixString
+    uint32_t words;       // nodes in use
+    uint32_t slots;       // size of the table
+    uint32_t maxProbe;    // the most probes to find a word
+    uint64_t hitProbes;   // probes to find every word once
+    uint64_t missProbes;  // probes for a miss starting at every slot
+    double load() const { return double(words) / slots; }
+    double meanHit() const {
+      return words == 0 ? 0 : double(hitProbes) / words;
+    }
+    double meanMiss() const { return double(missProbes) / slots; }
+  };
+  // call f(const BucketStats &) for every hash map, in prefix order
+  template <typename Func>
+  void forEachBucket(Func f) const {
+    uint32_t k = 0;
+    for (uint32_t d = 0; d < DIRECTORY_WORDS; d++)
+      for (uint64_t bits = directory[d].present; bits != 0; bits &= bits - 1)
+        f(hashmaps[k++].stats(*this, d * 64 + __builtin_ctzll(bits)));
   }
 
  private:
   void addWord(uint32_t base, uint32_t baseId, uint32_t hashVal,
                const char letters[], uint32_t len) {
     if (len == 0) {
+      sample(1);
       nodes[hashVal].offset = 1;  // special case for empty strings
       nodes[hashVal].relid =
-          info.numWords - baseId;  // if one hashmap must host more than 64k
-                                   // range, this won't work!
+          info.numWords - baseId;  // fits, add() checks MaxBucket
+      info.numWords++;
+      wordsInCurrentHashMap++;
       return;
     }
+    sample(info.textSize - base);
     nodes[hashVal].offset = info.textSize - base;  // offset to word in text;
     nodes[hashVal].relid =
-        info.numWords - baseId;  // if one hashmap must host more than 64k
-                                 // range, this won't work!
+        info.numWords - baseId;  // fits, add() checks MaxBucket
 
     uint32_t textSize = info.textSize;
-    for (int i = 0; i < len - 1; i++) text[textSize++] = letters[i];
+    for (uint32_t i = 0; i < len - 1; i++) text[textSize++] = letters[i];
     text[textSize++] =
         letters[len - 1] | 128;  // last letter has high bit set. Special case
                                  // for empty string is the special offset 1
@@ -216,28 +1499,28 @@ class TrieHashDict {
   class HashMapNode {
    public:
     // 0 = null
-    uint16_t
-        offset;      // where the text is relative to the base for this hash map
-    uint16_t relid;  // id number relative to baseid in hashmap
+    Offset offset;  // where the text is relative to the base for this hash map
+    RelId relid;    // id number relative to baseid in hashmap
   };
   class HashMap {
    public:
     uint32_t base;    // offset into giant string of all words,
                       // each node offset relative to this
     uint32_t baseid;  // all ids in this hash map are relative to this number
-    uint16_t size;    // size of the table
-    HashMap() : base(0), baseid(0), size(64) {}
-    HashMap(uint16_t base, uint32_t baseid, uint32_t size)
-        : base(base), baseid(baseid), size(size) {}
-    void grow(TrieHashDict &t) {
-      t.checkGrow(size);
-      HashMapNode *temp = t.temp;
+    uint32_t start;   // index of the first node of this hash map
+    uint32_t size;    // size of the table
+    HashMap() : base(0), baseid(0), start(0), size(64) {}
+    HashMap(uint16_t base, uint32_t baseid, uint32_t start, uint32_t size)
+        : base(base), baseid(baseid), start(start), size(size) {}
+    void grow(BasicTrieHashDict &t) {
       uint32_t oldSize = size;
       size = ((size + 1) << 1) - 1;  // 2 to n - 1
+      // the old nodes are parked just past the end of the new table
+      HashMapNode *temp = t.nodes + start + size + 1;
 
       uint32_t activeNodes = 0;
-      for (uint32_t i = t.startIndexOfCurrentHashMap;
-           i <= t.startIndexOfCurrentHashMap + oldSize; i++) {
+      TRIEHASH_STAT(t.stats.grows++);
+      for (uint32_t i = start; i <= start + oldSize; i++) {
         if (t.nodes[i].offset != 0) {
           temp[activeNodes++] = t.nodes[i];  // copy each node for safekeeping
           t.nodes[i].offset = 0;  // zero the offset so each looks empty
@@ -245,25 +1528,26 @@ class TrieHashDict {
       }
 
       // reinsert each node into the double-sized hashmap
+      TRIEHASH_STAT(t.stats.rehashed += activeNodes);
+      char word[256];
       for (uint32_t i = 0; i < activeNodes; i++) {
-        const char *p = t.text + base + temp[i].offset;
-        uint32_t len = strlen(p);            // TODO: inefficient
-        uint32_t h = baseid + hash(p, len);  // calculate new hash location
+        uint32_t len = suffixAt(t, temp[i], word);
+        uint32_t h = start + hash(word, len);  // calculate new hash location
         while (t.nodes[h].offset != 0) {
-          h++;                  // linear probe until collision resolved
-          if (h > base + size)  // if end of table, jump back to start
-            h = base;
+          h++;                   // linear probe until collision resolved
+          if (h > start + size)  // if end of table, jump back to start
+            h = start;
         }
-        t.nodes[h].offset = temp[i].offset;  // reinsert node in new location
-        t.nodes[h].relid = temp[i].relid;
+        t.nodes[h] = temp[i];  // reinsert node in new location
       }
-      t.info.nodeSize = baseid + size + 1;
+      memset(temp, 0, activeNodes * sizeof(HashMapNode));
+      t.info.nodeSize = start + size + 1;
     }
-    void add(TrieHashDict &t, const char word[], uint32_t len) {
-      uint32_t h = baseid + hash(word, len);
+    void add(BasicTrieHashDict &t, const char word[], uint32_t len) {
+      uint32_t h = start + hash(word, len);
       while (t.nodes[h].offset != 0) {
         h++;
-        if (h > baseid + size) h = baseid;
+        if (h > start + size) h = start;
       }
       t.addWord(base, baseid, h, word, len);
       if (t.wordsInCurrentHashMap * 2 > (size + 1)) {
@@ -273,26 +1557,88 @@ class TrieHashDict {
       //  0             256             512             792
       //  hm1 64
     }
-    bool get(const char word[], uint32_t len, uint32_t &id) {
-      uint32_t h = hash(word, len);  // linear probing. should be 50% empties
-      return false;                  // TODO: complete
+    bool get(const BasicTrieHashDict &t, const char word[], uint32_t len,
+             uint32_t &id) const {
+      return get(t, word, len, id, [](const void *, uint32_t) {});
+    }
+    // get, calling touch(p, bytes) for what it reads (see trace)
+    template <typename Touch>
+    bool get(const BasicTrieHashDict &t, const char word[], uint32_t len,
+             uint32_t &id, Touch &&touch) const {
+      uint32_t h = home(word, len);  // linear probing. 50% empties
+      TRIEHASH_STAT(uint32_t probes = 0);
+      for (;; h = h < start + size ? h + 1 : start) {
+        const HashMapNode &n = t.nodes[h];
+        touch(&n, sizeof(HashMapNode));
+        TRIEHASH_STAT(probes++);
+        if (n.offset == 0) {
+          TRIEHASH_STAT(t.stats.miss(probes));
+          return false;
+        }
+        if (n.offset == 1) {  // the empty suffix, ie the trigram is a word
+          if (len != 0) continue;
+        } else {
+          if (len == 0) continue;
+          TRIEHASH_STAT(t.stats.textCompares++);
+          const char *p = t.text + (base + n.offset);
+          uint32_t i = 0;
+          // stop at the end of the suffix too, in case word has a high bit
+          while (i < len - 1 && p[i] == word[i] && (p[i] & 128) == 0) i++;
+          touch(p, i + 1);
+          if (i < len - 1 || p[i] != char(word[i] | 128) ||
+              (word[i] & 128) != 0)
+            continue;
+        }
+        TRIEHASH_STAT(t.stats.hit(probes));
+        id = baseid + n.relid;
+        return true;
+      }
+    }
+
+    // copy the suffix stored for a node into word without the end bit
+    uint32_t suffixAt(const BasicTrieHashDict &t, const HashMapNode &n,
+                      char word[256]) const {
+      uint32_t len = 0;
+      if (n.offset != 1) {
+        const char *p = t.text + (base + n.offset);
+        do {
+          word[len] = p[len] & 127;
+        } while ((p[len++] & 128) == 0);
+      }
+      return len;
     }
 
-    uint32_t *get(const char word[], uint32_t len) {
-      return nullptr;  // TODO: complete
+    // the node where the search for a word starts
+    uint32_t home(const char word[], uint32_t len) const {
+      return start + hash(word, len);
     }
 
-    // abc != cba   abc != bbb
-    uint32_t hash(const char letters[], uint32_t len) {
-      if (len == 0) return 0;
-      uint32_t sum = len;
-      for (len--; len > 0; len--)
-        sum = ((sum << 11) | (sum >> 21)) ^
-              ((sum << 7) | (sum >> 25)) + letters[len];
-      sum =
-          ((sum << 11) | (sum >> 21)) ^ ((sum << 7) | (sum >> 25)) + letters[0];
-      return sum & size;  // size must be power of 2 - 1
+    BucketStats stats(const BasicTrieHashDict &t, uint32_t prefix) const {
+      BucketStats b = {prefix, 0, size + 1, 0, 0, 0};
+      char word[256];
+      for (uint32_t i = 0; i <= size; i++) {
+        const HashMapNode &n = t.nodes[start + i];
+        uint32_t run = 1;  // probes for a miss starting here
+        while (t.nodes[start + (i + run - 1) % (size + 1)].offset != 0 &&
+               run <= size + 1)
+          run++;
+        b.missProbes += run;
+        if (n.offset == 0) continue;
+        b.words++;
+        uint32_t h = home(word, suffixAt(t, n, word)) - start;
+        uint32_t probes = (i + size + 1 - h) % (size + 1) + 1;
+        b.hitProbes += probes;
+        b.maxProbe = std::max(b.maxProbe, probes);
+      }
+      return b;
+    }
+
+    uint32_t hash(const char letters[], uint32_t len) const {
+      return uint32_t(Hash::hash(letters, len)) & size;  // size = 2^n - 1
     }
   };
-  constexpr static uint32_t hashMapOffset = FIRST_3 * sizeof(HashMap);
 };
+
+using TrieHashDict = BasicTrieHashDict<>;
+// no 64k limits on the text or the words of a single hash map
+using TrieHashDict32 = BasicTrieHashDict<Alpha26, 3, uint32_t, uint32_t>;
@@ -1,5 +1,7 @@
 #include <cstdint>
 #include <iostream>
+
+#include "Alphabet.hh"
 //#include <bit> // this is only C++20
 using namespace std;
 /*
@@ -37,6 +39,7 @@ using namespace std;
 
 */
 
+template <typename Alphabet = Alpha26>
 class TrieHash2 {
  private:
   struct Node {
@@ -48,25 +51,29 @@ class TrieHash2 {
 
     uint16_t offset;  // relative pointer to child node (either trienode or hash
                       // table)
-    union {           // what, no anonymous unions in c++ anymore? WTF?
-      uint32_t next;  // bit vector for up to 32 next letters ie a, b, c, ...
-                      // position = offset + count of 1 bits in vector
-    };
-    Node(uint16_t offset) : trieNode(1), isWord(0), offset(offset), next(0) {}
-    uint16_t add(uint8_t c) {  // trie method only
-      if (c < 'a' || c > 'z') return 0;
-      uint8_t delta = c - 'a';
-      next |= (1 << delta);
-      return offset +
-             __builtin_popcount(
-                 next &
-                 (0xFFFFFFFF >> (32 - delta)));  // TODO: better way to do this?
+    // bit vector of next symbols ie a, b, c, ... a single 32 bit word for
+    // 26 letters, wider for bigger alphabets
+    // position = offset + count of 1 bits in vector
+    SymbolSet<Alphabet::size> next;
+    Node(uint16_t offset) : trieNode(1), isWord(0), offset(offset) {}
+    uint16_t add(uint32_t code) {  // trie method only, code from the alphabet
+      if (code >= Alphabet::size) return 0;
+      next.set(code);
+      return offset + next.rank(code);
     }
   };
+  Alphabet alphabet;
   Node root;
 
  public:
   TrieHash2() : root(0) {}
+  uint16_t add(uint8_t c) {
+    int32_t code = alphabet.index(c);
+    return code < 0 ? 0 : root.add(code);
+  }
 };
 
-int main() { TrieHash2 t; }
+int main() {
+  TrieHash2<> t;
+  TrieHash2<ByteAlphabet<>> wide;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "WordHash.hh"
+
+/*
+  A blocked Bloom filter over whole words, to turn most misses away before
+  they reach a hash map.
+
+  The filter is an array of 32-byte blocks, each eight 32-bit words. A word
+  hashes to one block and sets one bit in each of its eight words, the bit
+  picked by multiplying the low half of the hash by a different odd salt
+  and keeping the top 5 bits (the split block filter of Impala and
+  Parquet). So a query reads one block, never more than one cache line,
+  and with AVX2 the eight bits are made and tested in a handful of
+  instructions. At 10 bits per word about 1% of the words that are not in
+  the dictionary get through.
+
+  The hash is WordHash with a seed of its own, whatever hash the dictionary
+  uses for its suffixes, so the filter is the same on every machine.
+*/
+class WordFilter {
+ public:
+  struct Block {
+    uint32_t bits[8];
+  };
+
+ private:
+  static constexpr uint64_t SEED = 0x9e3779b97f4a7c15ULL;
+  static constexpr uint32_t SALT[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU,
+                                       0xa2b7289dU, 0x705495c7U, 0x2df1424bU,
+                                       0x9efc4947U, 0x5c6bfb31U};
+
+  static const Block &blockOf(const Block blocks[], uint32_t n, uint64_t h) {
+    return blocks[((h >> 32) * n) >> 32];
+  }
+
+ public:
+  // blocks for words words at bitsPerWord bits each, at least 1
+  static uint32_t blocksFor(uint64_t words, uint32_t bitsPerWord) {
+    uint64_t n = (words * bitsPerWord + 255) / 256;
+    return n == 0 ? 1 : n;
+  }
+
+  static void add(Block blocks[], uint32_t n, const char word[], uint32_t len) {
+    uint64_t h = WordHash::hash(word, len, SEED);
+    Block &b = const_cast<Block &>(blockOf(blocks, n, h));
+    for (uint32_t i = 0; i < 8; i++)
+      b.bits[i] |= 1U << ((uint32_t(h) * SALT[i]) >> 27);
+  }
+
+  // false if word is certainly not one of the words added
+  static bool mayContain(const Block blocks[], uint32_t n, const char word[],
+                         uint32_t len) {
+    uint64_t h = WordHash::hash(word, len, SEED);
+    const Block &b = blockOf(blocks, n, h);
+#ifdef __AVX2__
+    const __m256i salt = _mm256_loadu_si256((const __m256i *)SALT);
+    __m256i shift = _mm256_srli_epi32(
+        _mm256_mullo_epi32(_mm256_set1_epi32(uint32_t(h)), salt), 27);
+    __m256i want = _mm256_sllv_epi32(_mm256_set1_epi32(1), shift);
+    return _mm256_testc_si256(_mm256_loadu_si256((const __m256i *)b.bits),
+                              want);
+#else
+    for (uint32_t i = 0; i < 8; i++)
+      if ((b.bits[i] >> ((uint32_t(h) * SALT[i]) >> 27) & 1) == 0) return false;
+    return true;
+#endif
+  }
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+/*
+  Hash functions for the suffixes stored in the hash maps. A hash is a class
+  with a static hash(letters, len) so the dictionary takes it as a template
+  parameter and the call inlines.
+
+  WordHash reads the word 8 bytes at a time and mixes with a 64x64->128 bit
+  multiply, folding the high half into the low (the wyhash construction).
+  Words up to 16 bytes, which is nearly all of them, take two or four
+  overlapping loads and two multiplies, no loop. All loads stay inside the
+  word, so reading a suffix at the end of a buffer is safe. Every output bit
+  depends on every input bit, so masking with the table size is fine.
+
+  RotateXorHash is the original byte-at-a-time hash, kept to compare against
+  (see compareHashes.cc). It computes rot11 ^ (rot7 + c) because of operator
+  precedence, and its low bits cluster, which is what the mask keeps.
+*/
+class WordHash {
+ public:
+  static constexpr uint32_t id = 1;  // recorded in saved files
+
+ private:
+  static constexpr uint64_t s0 = 0xa0761d6478bd642fULL;
+  static constexpr uint64_t s1 = 0xe7037ed1a0b428dbULL;
+  static constexpr uint64_t s2 = 0x8ebc6af09c88c6e3ULL;
+
+  static uint64_t mix(uint64_t a, uint64_t b) {
+    __uint128_t r = (__uint128_t)a * b;
+    return uint64_t(r) ^ uint64_t(r >> 64);
+  }
+  static uint64_t read64(const char p[]) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+  }
+  static uint64_t read32(const char p[]) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+  }
+
+ public:
+  static uint64_t hash(const char p[], uint32_t len, uint64_t seed = s2) {
+    uint64_t a, b;
+    if (len <= 16) {
+      if (len >= 4) {
+        uint32_t mid = (len >> 3) << 2;  // 0 for 4-7 bytes, 4 for 8-16
+        a = (read32(p) << 32) | read32(p + mid);
+        b = (read32(p + len - 4) << 32) | read32(p + len - 4 - mid);
+      } else if (len > 0) {
+        a = (uint64_t(uint8_t(p[0])) << 16) |
+            (uint64_t(uint8_t(p[len >> 1])) << 8) | uint8_t(p[len - 1]);
+        b = 0;
+      } else {
+        a = b = 0;
+      }
+    } else {
+      uint32_t i = len;
+      for (; i > 16; i -= 16, p += 16)
+        seed = mix(read64(p) ^ s1, read64(p + 8) ^ seed);
+      a = read64(p + i - 16);  // the last 16 bytes, overlapping if need be
+      b = read64(p + i - 8);
+    }
+    return mix(s0 ^ len, mix(a ^ s1, b ^ seed));
+  }
+};
+
+class RotateXorHash {
+ public:
+  static constexpr uint32_t id = 2;
+  // abc != cba   abc != bbb
+  static uint64_t hash(const char letters[], uint32_t len) {
+    if (len == 0) return 0;
+    uint32_t sum = len;
+    for (len--; len > 0; len--)
+      sum = ((sum << 11) | (sum >> 21)) ^
+            (((sum << 7) | (sum >> 25)) + letters[len]);
+    sum =
+        ((sum << 11) | (sum >> 21)) ^ (((sum << 7) | (sum >> 25)) + letters[0]);
+    return sum;
+  }
+};
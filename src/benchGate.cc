@@ -0,0 +1,127 @@
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+
+using namespace std;
+
+/*
+  Fail a change that makes the benchmarks slower or bigger. Compares the
+  JSON lines of two runs of benchTrieHashDict (or anything that reports
+  through Benchmark.hh), matching results by bench and impl:
+
+    times     the current min ns/op against the baseline's, or p50 given
+              p50; min is the steadiest on a busy machine
+    checks    must be the same, a different checksum means different
+              answers
+    sizes     bytes, deterministic, held to the same tolerance
+
+  usage: benchGate baseline.jsonl current.jsonl [tolerance%=10] [min|p50]
+
+  Prints every result with its change and exits 1 if any time or size grew
+  by more than the tolerance, any checksum changed, or a result of the
+  baseline is missing. Results only in the current run are listed as new.
+  Run both on the same machine, with several trials:
+
+    ./benchTrieHashDict dict.txt 11 > base.jsonl      # before the change
+    ./benchTrieHashDict dict.txt 11 > new.jsonl       # after
+    ./benchGate base.jsonl new.jsonl 10
+*/
+
+struct Result {
+  double value;  // ns/op, or bytes
+  string check;  // empty for sizes
+  bool isSize;
+};
+
+// the value of "key": in a line of flat JSON, empty if it has none
+static string field(const string &line, const string &key) {
+  string k = "\"" + key + "\":";
+  size_t at = line.find(k);
+  if (at == string::npos) return "";
+  at += k.size();
+  if (line[at] == '"')
+    return line.substr(at + 1, line.find('"', at + 1) - at - 1);
+  return line.substr(at, line.find_first_of(",}", at) - at);
+}
+
+static map<pair<string, string>, Result> readResults(const char filename[],
+                                                     const string &metric) {
+  ifstream f(filename);
+  if (!f) throw "Could not open benchmark results";
+  map<pair<string, string>, Result> results;
+  for (string line; getline(f, line);) {
+    string bench = field(line, "bench"), impl = field(line, "impl");
+    if (bench.empty()) continue;
+    Result r;
+    string bytes = field(line, "bytes");
+    r.isSize = !bytes.empty();
+    r.value = atof((r.isSize ? bytes : field(line, metric + "_ns_op")).c_str());
+    r.check = field(line, "check");
+    // a repeated bench and impl is numbered, so each is compared in order
+    pair<string, string> key(bench, impl);
+    for (uint32_t n = 2; results.count(key) != 0; n++)
+      key.second = impl + " #" + to_string(n);
+    results[key] = r;
+  }
+  return results;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    cerr << "usage: benchGate baseline.jsonl current.jsonl [tolerance%] "
+            "[min|p50]\n";
+    return 1;
+  }
+  double tolerance = argc > 3 ? atof(argv[3]) : 10;
+  string metric = argc > 4 ? argv[4] : "min";
+  if (metric != "min" && metric != "p50") {
+    cerr << "the metric is min or p50\n";
+    return 1;
+  }
+  try {
+    auto base = readResults(argv[1], metric);
+    auto current = readResults(argv[2], metric);
+    uint32_t failed = 0;
+    for (const auto &b : base) {
+      const string &bench = b.first.first, &impl = b.first.second;
+      cout << left << setw(20) << bench << setw(30) << impl << right;
+      auto c = current.find(b.first);
+      if (c == current.end()) {
+        cout << "  missing\n";
+        failed++;
+        continue;
+      }
+      const Result &was = b.second, &now = c->second;
+      double change = was.value == 0 ? 0 : 100 * (now.value / was.value - 1);
+      cout << fixed << setprecision(2) << setw(14) << was.value << setw(14)
+           << now.value << (now.isSize ? " bytes " : " ns/op ") << showpos
+           << setprecision(1) << setw(7) << change << '%' << noshowpos;
+      if (now.check != was.check) {
+        cout << "  checksum " << was.check << " -> " << now.check;
+        failed++;
+      } else if (change > tolerance) {
+        cout << (now.isSize ? "  BIGGER" : "  SLOWER");
+        failed++;
+      }
+      cout << '\n';
+    }
+    for (const auto &c : current)
+      if (base.count(c.first) == 0)
+        cout << left << setw(20) << c.first.first << setw(30)
+             << c.first.second << "  new\n";
+    if (failed != 0) {
+      cout << failed << " of " << base.size() << " results failed the gate ("
+           << tolerance << "% on " << metric << ")\n";
+      return 1;
+    }
+    cout << "all " << base.size() << " results within " << tolerance
+         << "% on " << metric << '\n';
+  } catch (const char *msg) {
+    cerr << msg << '\n';
+    return 1;
+  }
+}
@@ -0,0 +1,424 @@
+#include <malloc.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Benchmark.hh"
+#include "Compressed3letterTrie.hh"
+#include "LookupCache.hh"
+#include "PackedSymbols.hh"
+#include "Tokenizer.hh"
+#include "TrieDict.hh"
+
+using namespace std;
+
+/*
+  Benchmark the dictionaries on dict.txt against std::unordered_map and
+  std::set:
+
+    build, save, load         the whole dictionary, ns per word
+    load_async_first          AsyncLoader until the first lookup can be
+                              served, with io_uring and with the pread pool
+    load_async                AsyncLoader until the whole image is in
+    lookup_hit                every word, shuffled
+    lookup_miss               near misses, each word with its last letter
+                              changed or a letter appended
+    lookup_zipf               1M queries, word popularity following Zipf(1)
+    lookup_cold               10k random hits after flushing the caches
+    lookup_batch              lookup_hit through getBatch, for TrieHashDict
+                              and the compressed 3 letter dictionary
+    lookup_coro               lookup_hit through getAsync, 16 lookups in
+                              flight (only when compiled as C++20)
+    (TrieHashDict hot)        the lookups again after prioritize() with the
+                              popularity of lookup_zipf, hot table included
+    (TrieHashDict filter)     the lookups again with a 10 bit per word filter
+                              saved in the image, with its false positive rate
+    (cached)                  the lookups through a 4096 entry LookupCache,
+                              for TrieHashDict and the compressed 3 letter
+                              dictionary, with the cache hit rate
+    decode_packed             base 27 blocks of the compressed format, ns per
+                              block
+    tokenize                  splitting the words back out of text, ns per
+                              word, byte by byte and with Tokenizer
+    memory                    bytes and bytes per word
+
+  usage: benchTrieHashDict [dict.txt] [trials] > results.jsonl
+  The table goes to stderr, one JSON object per result to stdout. Queries
+  come from a fixed seed so every run asks the same questions.
+
+  Only words of at least 3 letters are used because the compressed
+  dictionaries do not store shorter ones. Ids are given in the same order to
+  the std containers so the checksums of hits agree between implementations.
+*/
+
+// live heap bytes, so the std containers can be measured. Atomic because
+// AsyncLoader allocates from its reader threads
+static atomic<uint64_t> liveBytes(0);
+void *operator new(size_t n) {
+  void *p = malloc(n);
+  if (p == nullptr) throw bad_alloc();
+  liveBytes.fetch_add(malloc_usable_size(p), memory_order_relaxed);
+  return p;
+}
+void operator delete(void *p) noexcept {
+  if (p != nullptr)
+    liveBytes.fetch_sub(malloc_usable_size(p), memory_order_relaxed);
+  free(p);
+}
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+
+struct Queries {
+  vector<string> words;  // the dictionary, in order
+  vector<string> hits;
+  vector<string> misses;
+  vector<string> zipf;
+  vector<string> cold;
+};
+
+void readWords(const char filename[], vector<string> &words) {
+  ifstream f(filename);
+  string w;
+  while (f >> w)
+    if (w.size() >= 3) words.push_back(w);
+}
+
+void makeQueries(Queries &q) {
+  mt19937_64 rng(20260101);
+  q.hits = q.words;
+  shuffle(q.hits.begin(), q.hits.end(), rng);
+
+  unordered_set<string> dict(q.words.begin(), q.words.end());
+  for (const string &w : q.hits) {
+    string m = w;
+    for (char c = 'a'; c <= 'z'; c++) {
+      m.back() = c;
+      if (dict.count(m) == 0) break;
+    }
+    if (dict.count(m) != 0) m = w + 'q';
+    if (dict.count(m) == 0) q.misses.push_back(m);
+  }
+
+  // the shuffled order is the popularity order, rank r has weight 1/r
+  vector<double> cdf(q.hits.size());
+  double sum = 0;
+  for (uint32_t r = 0; r < cdf.size(); r++) cdf[r] = sum += 1.0 / (r + 1);
+  uniform_real_distribution<double> u(0, sum);
+  for (uint32_t i = 0; i < 1000000; i++) {
+    uint32_t r = lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin();
+    q.zipf.push_back(q.hits[min<uint32_t>(r, q.hits.size() - 1)]);
+  }
+
+  uniform_int_distribution<uint32_t> pick(0, q.words.size() - 1);
+  for (uint32_t i = 0; i < 10000; i++) q.cold.push_back(q.words[pick(rng)]);
+}
+
+// touch more memory than the last level cache holds
+void flushCaches() {
+  static vector<uint64_t> junk(64 << 17);  // 64MB
+  static uint64_t sum = 0;
+  for (uint64_t &v : junk) sum += v++;
+}
+
+/*
+  Run every lookup workload on one implementation. find(word) returns the
+  id of a word, or 0 if it is missing.
+*/
+template <typename Find>
+void lookups(Benchmark &b, const char impl[], const Queries &q,
+             uint32_t trials, Find find) {
+  auto all = [&find](const vector<string> &qs) {
+    return [&find, &qs]() {
+      uint64_t sum = 0;
+      for (const string &w : qs) sum += find(w);
+      return sum;
+    };
+  };
+  b.run("lookup_hit", impl, q.hits.size(), trials, all(q.hits));
+  b.run("lookup_miss", impl, q.misses.size(), trials, all(q.misses));
+  b.run("lookup_zipf", impl, q.zipf.size(), trials, all(q.zipf));
+  b.run("lookup_cold", impl, q.cold.size(), trials, flushCaches, all(q.cold));
+}
+
+void benchTrieHashDict(Benchmark &b, const Queries &q, uint32_t trials) {
+  const char impl[] = "TrieHashDict";
+  const char bin[] = "bench.bin";
+  uint64_t before = liveBytes;
+  {
+    TrieHashDict *d = nullptr;
+    b.run(
+        "build", impl, q.words.size(), trials,
+        [&d] {
+          delete d;
+          d = nullptr;
+        },
+        [&d, &q] {
+          d = new TrieHashDict();
+          for (const string &w : q.words) d->add(w.data(), w.size());
+          return uint64_t(d->numWords());
+        });
+    b.reportBytes("memory_build", impl, liveBytes - before, q.words.size());
+    b.reportBytes("memory", impl, d->imageSize(), q.words.size());
+    b.run("save", impl, q.words.size(), trials, [d, bin] {
+      d->save(bin);
+      return d->imageSize();
+    });
+    delete d;
+  }
+  b.run("load", impl, q.words.size(), trials, [bin] {
+    TrieHashDict d(bin);
+    return uint64_t(d.numWords());
+  });
+  for (bool uring : {true, false}) {
+    const char *how = uring ? "TrieHashDict io_uring" : "TrieHashDict pread";
+    b.run("load_async_first", how, q.words.size(), trials, [bin, uring] {
+      AsyncLoader l(bin, 1 << 20, 32, 4, uring);
+      TrieHashDict d(l);
+      return uint64_t(d.numWords());
+    });
+    b.run("load_async", how, q.words.size(), trials, [bin, uring] {
+      AsyncLoader l(bin, 1 << 20, 32, 4, uring);
+      TrieHashDict d(l);
+      l.wait();
+      return uint64_t(d.numWords());
+    });
+  }
+
+  TrieHashDict d(bin);
+  lookups(b, impl, q, trials, [&d](const string &w) {
+    uint32_t id = 0;
+    d.get(w.data(), w.size(), id);
+    return id;
+  });
+
+  vector<const char *> words;
+  vector<uint32_t> lens;
+  for (const string &w : q.hits) {
+    words.push_back(w.data());
+    lens.push_back(w.size());
+  }
+  vector<uint32_t> ids(words.size());
+  b.run("lookup_batch", impl, words.size(), trials, [&] {
+    d.getBatch(words.data(), lens.data(), words.size(), ids.data());
+    uint64_t sum = 0;
+    for (uint32_t id : ids) sum += id;
+    return sum;
+  });
+#ifdef TRIEHASH_COROUTINES
+  // 16 handlers each looking up every 16th word one at a time
+  b.run("lookup_coro", impl, words.size(), trials, [&] {
+    uint64_t sum = 0;
+    auto handler = [&](uint32_t first) -> CoroTask<> {
+      for (uint32_t i = first; i < words.size(); i += 16)
+        sum += co_await d.getAsync(words[i], lens[i]);
+    };
+    CoroScheduler s;
+    for (uint32_t k = 0; k < 16; k++) s.spawn(handler(k));
+    s.run();
+    return sum;
+  });
+#endif
+
+  // the same dictionary laid out by the popularity lookup_zipf draws from
+  unordered_map<string, uint64_t> weight;
+  for (uint32_t r = 0; r < q.hits.size(); r++)
+    weight[q.hits[r]] = q.hits.size() - r;
+  {
+    TrieHashDict built;
+    for (const string &w : q.words) built.add(w.data(), w.size());
+    built.prioritize([&weight](const char word[], uint32_t len) {
+      return weight[string(word, len)];
+    });
+    built.save(bin);
+  }
+  TrieHashDict hot(bin);
+  b.reportBytes("memory", "TrieHashDict hot", hot.imageSize(), q.words.size());
+  lookups(b, "TrieHashDict hot", q, trials, [&hot](const string &w) {
+    uint32_t id = 0;
+    hot.get(w.data(), w.size(), id);
+    return id;
+  });
+
+  // and with a filter of 10 bits per word in the image
+  {
+    TrieHashDict built;
+    for (const string &w : q.words) built.add(w.data(), w.size());
+    built.save(bin, 10);
+  }
+  TrieHashDict filtered(bin);
+  b.reportBytes("memory", "TrieHashDict filter", filtered.imageSize(),
+                q.words.size());
+  b.reportBytes("memory_filter", "TrieHashDict filter", filtered.filterSize(),
+                q.words.size());
+  lookups(b, "TrieHashDict filter", q, trials, [&filtered](const string &w) {
+    uint32_t id = 0;
+    filtered.get(w.data(), w.size(), id);
+    return id;
+  });
+  uint64_t passed = 0;
+  for (const string &w : q.misses)
+    passed += filtered.mayContain(w.data(), w.size());
+  cerr << "TrieHashDict filter: " << fixed << setprecision(2)
+       << 100.0 * passed / q.misses.size() << "% of lookup_miss got past it\n";
+}
+
+void benchUnorderedMap(Benchmark &b, const Queries &q, uint32_t trials) {
+  const char impl[] = "std::unordered_map";
+  unordered_map<string, uint32_t> m;
+  uint64_t before = liveBytes;
+  b.run(
+      "build", impl, q.words.size(), trials, [&m] { m.clear(); },
+      [&m, &q] {
+        uint32_t id = 1;
+        for (const string &w : q.words) m[w] = id++;
+        return uint64_t(m.size());
+      });
+  b.reportBytes("memory", impl, liveBytes - before, q.words.size());
+  lookups(b, impl, q, trials, [&m](const string &w) {
+    auto i = m.find(w);
+    return i == m.end() ? 0 : i->second;
+  });
+}
+
+void benchSet(Benchmark &b, const Queries &q, uint32_t trials) {
+  const char impl[] = "std::set";
+  set<string> s;
+  uint64_t before = liveBytes;
+  b.run(
+      "build", impl, q.words.size(), trials, [&s] { s.clear(); },
+      [&s, &q] {
+        for (const string &w : q.words) s.insert(s.end(), w);
+        return uint64_t(s.size());
+      });
+  b.reportBytes("memory", impl, liveBytes - before, q.words.size());
+  lookups(b, impl, q, trials,
+          [&s](const string &w) { return uint32_t(s.count(w)); });
+}
+
+// the lookups through a LookupCache, on the dictionary the cache is for
+template <typename Dict>
+void cached(Benchmark &b, const char impl[], const Queries &q, uint32_t trials,
+            const Dict &d) {
+  LookupCache<Dict> cache(d);
+  lookups(b, impl, q, trials, [&cache](const string &w) {
+    uint32_t id = 0;
+    cache.get(w.data(), w.size(), id);
+    return id;
+  });
+  cerr << impl << ": cache hit rate " << fixed << setprecision(1)
+       << 100 * cache.getStats().cacheHitRate() << "% over all the lookups\n";
+}
+
+void benchCache(Benchmark &b, const Queries &q, const char dictFile[],
+                uint32_t trials) {
+  {
+    TrieHashDict built;
+    for (const string &w : q.words) built.add(w.data(), w.size());
+    built.save("bench.bin");
+  }
+  TrieHashDict d("bench.bin");
+  cached(b, "TrieHashDict cached", q, trials, d);
+
+  const char bin[] = "bench3.bin";
+  try {
+    CompressedDict<>(dictFile).writeCompressed(bin);
+  } catch (const char *msg) {
+    cerr << "no compressed dictionary: " << msg << '\n';
+    return;
+  }
+  CompressedDictReader<> r(bin);
+  lookups(b, "Compressed3", q, trials, [&r](const string &w) {
+    uint32_t id = 0;
+    r.get(w.data(), w.size(), id);
+    return id;
+  });
+  vector<const char *> words;
+  vector<uint32_t> lens;
+  for (const string &w : q.hits) {
+    words.push_back(w.data());
+    lens.push_back(w.size());
+  }
+  vector<uint32_t> ids(words.size());
+  b.run("lookup_batch", "Compressed3", words.size(), trials, [&] {
+    r.getBatch(words.data(), lens.data(), words.size(), ids.data());
+    uint64_t sum = 0;
+    for (uint32_t id : ids) sum += id;
+    return sum;
+  });
+  cached(b, "Compressed3 cached", q, trials, r);
+}
+
+// decode speed of the base 27 blocks used by the compressed dictionaries
+void benchDecode(Benchmark &b, const Queries &q, uint32_t trials) {
+  using Packing = SymbolPacking<Alpha26::size>;
+  vector<uint64_t> blocks;
+  SymbolPacker<Alpha26::size> packer(blocks);
+  for (const string &w : q.words) {
+    for (char c : w) packer.put(Alpha26::index(c));
+    packer.put(Packing::END);
+  }
+  packer.flush();
+  b.reportBytes("memory", "packed base 27", blocks.size() * sizeof(uint64_t),
+                q.words.size());
+  b.run("decode_packed", "SymbolPacking<26>", blocks.size(), trials,
+        [&blocks] {
+          uint8_t digits[Packing::perWord];
+          uint64_t words = 0;
+          for (uint64_t w : blocks) {
+            Packing::unpack(w, digits);
+            for (uint8_t d : digits) words += d == Packing::END;
+          }
+          return words;
+        });
+}
+
+// splitting text into words, the byte loop the builders had against Tokenizer
+void benchTokenize(Benchmark &b, const Queries &q, uint32_t trials) {
+  string text;
+  for (const string &w : q.words) text += w + '\n';
+  b.run("tokenize", "byte loop", q.words.size(), trials, [&text] {
+    const char *buf = text.data();
+    uint64_t size = text.size(), sum = 0;
+    for (uint64_t i = 0; i < size;) {
+      while (i < size && uint8_t(buf[i]) <= ' ') i++;
+      uint64_t k;
+      for (k = i; k < size && uint8_t(buf[k]) > ' '; k++)
+        ;
+      sum += k - i;
+      i = k;
+    }
+    return sum;
+  });
+  b.run("tokenize", "Tokenizer<NON_SPACE>", q.words.size(), trials, [&text] {
+    Tokenizer<NON_SPACE> tok(text.data(), text.size());
+    uint64_t sum = 0;
+    for (Tokenizer<NON_SPACE>::Span w; tok.next(w);) sum += w.len;
+    return sum;
+  });
+}
+
+int main(int argc, char *argv[]) {
+  const char *dictFile = argc > 1 ? argv[1] : "dict.txt";
+  uint32_t trials = argc > 2 ? atoi(argv[2]) : 11;
+  Queries q;
+  readWords(dictFile, q.words);
+  if (q.words.empty()) {
+    cerr << "no words in " << dictFile << '\n';
+    return 1;
+  }
+  makeQueries(q);
+  Benchmark b(cout, cerr);
+  benchTrieHashDict(b, q, trials);
+  benchUnorderedMap(b, q, trials);
+  benchSet(b, q, trials);
+  benchCache(b, q, dictFile, trials);
+  benchDecode(b, q, trials);
+  benchTokenize(b, q, trials);
+}
@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Benchmark.hh"
+#include "MultiDict.hh"
+
+using namespace std;
+
+/*
+  Build a MultiDict image from word lists, one per dictionary, and compare
+  it with a TrieHashDict for each list: the bytes of the images, and the
+  time to find which dictionaries contain a word with one lookup against
+  one lookup per dictionary, over the words of all the lists.
+
+  usage: buildMultiDict out.bin name=words.txt [name=words.txt...]
+*/
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    cerr << "usage: buildMultiDict out.bin name=words.txt "
+            "[name=words.txt...]\n";
+    return 1;
+  }
+  try {
+    vector<string> names, files;
+    for (int i = 2; i < argc; i++) {
+      string a = argv[i];
+      size_t eq = a.find('=');
+      if (eq == string::npos) throw "each list is name=words.txt";
+      names.push_back(a.substr(0, eq));
+      files.push_back(a.substr(eq + 1));
+    }
+    {
+      MultiDict built(names, files);
+      built.save(argv[1]);
+    }
+    MultiDict multi(argv[1]);
+
+    // each list alone, sorted the same way
+    vector<unique_ptr<MultiDict>> separate;
+    vector<string> queries;
+    uint64_t separateBytes = 0;
+    for (uint32_t k = 0; k < files.size(); k++) {
+      separate.emplace_back(new MultiDict({names[k]}, {files[k]}));
+      separateBytes += separate.back()->getDict().imageSize();
+      ifstream f(files[k]);
+      for (string w; f >> w;) queries.push_back(w);
+    }
+    shuffle(queries.begin(), queries.end(), mt19937(1));
+
+    cout << argv[1] << ": " << multi.numDictionaries() << " dictionaries, "
+         << multi.getDict().numWords() << " distinct words of "
+         << queries.size() << '\n'
+         << "one image      " << setw(10) << multi.imageSize() << " bytes\n"
+         << "separate       " << setw(10) << separateBytes << " bytes\n";
+
+    Benchmark b(cout, cerr);
+    b.run("which", "MultiDict", queries.size(), 5, [&multi, &queries] {
+      uint64_t sum = 0;
+      for (const string &w : queries) sum += multi.which(w.data(), w.size());
+      return sum;
+    });
+    b.run("which", "TrieHashDict each", queries.size(), 5,
+          [&separate, &queries] {
+            uint64_t sum = 0;
+            uint32_t id;
+            for (const string &w : queries)
+              for (uint32_t k = 0; k < separate.size(); k++)
+                if (separate[k]->getDict().get(w.data(), w.size(), id))
+                  sum += 1ULL << k;
+            return sum;
+          });
+  } catch (const char *msg) {
+    cerr << msg << '\n';
+    return 1;
+  }
+}
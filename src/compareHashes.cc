@@ -0,0 +1,79 @@
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "Benchmark.hh"
+#include "TrieDict.hh"
+
+using namespace std;
+
+/*
+  Compare suffix hash functions on a dictionary: build it once with each,
+  then report the probe lengths computed from the hash maps and time lookups
+  of every word and of near misses.
+
+  usage: compareHashes [dict.txt] [trials] > results.jsonl
+*/
+
+template <typename Hash>
+using Dict = BasicTrieHashDict<Alpha26, 3, uint16_t, uint16_t, 65535, Hash>;
+
+template <typename Hash>
+void compare(Benchmark &b, const char impl[], const vector<string> &words,
+             const vector<string> &hits, const vector<string> &misses,
+             uint32_t trials) {
+  Dict<Hash> dict;
+  for (const string &w : words) dict.add(w.data(), w.size());
+
+  uint64_t n = 0, slots = 0, hit = 0, miss = 0;
+  uint32_t maxProbe = 0;
+  dict.forEachBucket([&](const typename Dict<Hash>::BucketStats &s) {
+    n += s.words;
+    slots += s.slots;
+    hit += s.hitProbes;
+    miss += s.missProbes;
+    maxProbe = max(maxProbe, s.maxProbe);
+  });
+  cerr << impl << ": load " << fixed << setprecision(3) << double(n) / slots
+       << ", probes per hit " << double(hit) / n << " (max " << maxProbe
+       << "), per miss " << double(miss) / slots << '\n';
+  cout << "{\"bench\":\"probes\",\"impl\":\"" << impl
+       << "\",\"hit_probes\":" << double(hit) / n
+       << ",\"max_hit_probes\":" << maxProbe
+       << ",\"miss_probes\":" << double(miss) / slots << "}\n";
+
+  auto all = [&dict](const vector<string> &qs) {
+    return [&dict, &qs]() {
+      uint64_t sum = 0;
+      uint32_t id;
+      for (const string &w : qs)
+        if (dict.get(w.data(), w.size(), id)) sum += id;
+      return sum;
+    };
+  };
+  b.run("lookup_hit", impl, hits.size(), trials, all(hits));
+  b.run("lookup_miss", impl, misses.size(), trials, all(misses));
+}
+
+int main(int argc, char *argv[]) {
+  ifstream f(argc > 1 ? argv[1] : "dict.txt");
+  uint32_t trials = argc > 2 ? atoi(argv[2]) : 11;
+  vector<string> words;
+  string w;
+  while (f >> w)
+    if (w.size() >= 3) words.push_back(w);
+
+  mt19937_64 rng(20260101);
+  vector<string> hits = words, misses;
+  shuffle(hits.begin(), hits.end(), rng);
+  unordered_set<string> dict(words.begin(), words.end());
+  for (const string &h : hits)
+    if (dict.count(h + 'q') == 0) misses.push_back(h + 'q');
+
+  Benchmark b(cout, cerr);
+  compare<RotateXorHash>(b, "RotateXorHash", words, hits, misses, trials);
+  compare<WordHash>(b, "WordHash", words, hits, misses, trials);
+}
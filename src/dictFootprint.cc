@@ -0,0 +1,162 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "Compressed3letterTrie.hh"
+#include "TrieDict.hh"
+
+using namespace std;
+
+/*
+  Where the bytes of a saved dictionary go, to compare the formats by
+  bytes per word: every section of the file with its bits per word, the
+  file header and the alignment padding between sections, and for each
+  kind what it wastes:
+
+    TrieHashDict          empty node slots and the sizes of the hash maps
+    compressed 3 letter   the count header, the padding ending each bin,
+                          and the sizes of the bins
+    recursive trie        the sections only (CompressedDict.cc reports the
+                          rest as it builds one)
+
+  usage: dictFootprint dict.bin [crunched.bin] [alignment=64]
+
+  Given crunched.bin, the same dictionary is written there with its
+  sections on alignment bytes rather than a page each.
+*/
+
+const char *sectionName(uint32_t id) {
+  switch (id) {
+    case SECTION_INFO: return "info";
+    case SECTION_ALPHABET: return "alphabet";
+    case SECTION_TEXT: return "text";
+    case SECTION_DIRECTORY: return "directory";
+    case SECTION_HASHMAPS: return "hash maps";
+    case SECTION_NODES: return "nodes";
+    case SECTION_HOT: return "hot words";
+    case SECTION_SHORT: return "short words";
+    case SECTION_RANK: return "rank samples";
+    case SECTION_FILTER: return "filter";
+    case SECTION_COMPRESSED_HEADER: return "compressed header";
+    case SECTION_COMPRESSED_WORDS: return "compressed words";
+  }
+  return "unknown";
+}
+
+void line(const char name[], uint64_t bytes, uint64_t words) {
+  cout << left << setw(20) << name << right << setw(12) << bytes << setw(10)
+       << fixed << setprecision(2) << (words == 0 ? 0 : 8.0 * bytes / words)
+       << '\n';
+}
+
+// counts in ranges of powers of 2: 0, 1, 2-3, 4-7, ...
+struct PowerHistogram {
+  uint64_t count[33] = {0}, sum[33] = {0};
+  void add(uint64_t v) {
+    uint32_t b = v == 0 ? 0 : 64 - __builtin_clzll(v);
+    count[b]++;
+    sum[b] += v;
+  }
+  void print(const char what[], const char of[]) const {
+    cout << '\n' << setw(12) << what << setw(10) << "count" << setw(12) << of
+         << '\n';
+    for (uint32_t b = 0; b < 33; b++) {
+      if (count[b] == 0) continue;
+      string range = b <= 1 ? to_string(b)
+                            : to_string(1ULL << (b - 1)) + "-" +
+                                  to_string((1ULL << b) - 1);
+      cout << setw(12) << range << setw(10) << count[b] << setw(12) << sum[b]
+           << '\n';
+    }
+  }
+};
+
+void trieHash(const char filename[], uint64_t &words) {
+  TrieHashDict dict(filename);
+  TrieHashDict::Footprint f = dict.footprint();
+  words = dict.numWords();
+  cout << "empty node slots " << f.emptySlots << " of " << f.slots << ", "
+       << f.emptySlotBytes() << " bytes, " << fixed << setprecision(1)
+       << 100.0 * f.emptySlotBytes() / f.image() << "% of the image\n";
+  PowerHistogram h;
+  dict.forEachBucket([&h](const TrieHashDict::BucketStats &b) {
+    h.add(b.words);
+  });
+  h.print("words/map", "words");
+}
+
+void compressed3(const char filename[], uint64_t &words) {
+  using Reader = CompressedDictReader<>;
+  using Packing = SymbolPacking<Alpha26::size>;
+  Reader r(filename);
+  words = r.numWords();
+  uint64_t used = 0, symbols = 0;
+  PowerHistogram h;
+  for (uint32_t bin = 0; bin < Reader::FIRST_N; bin++) {
+    used += r.blocks(bin) != 0;
+    h.add(r.blocks(bin));
+    r.forEachSuffix(bin, [&symbols](const uint8_t[], uint32_t len) {
+      symbols += len + 1;
+    });
+  }
+  uint64_t digits = r.wordBytes() / sizeof(uint64_t) * Packing::perWord;
+  cout << used << " of " << Reader::FIRST_N << " bins used, header "
+       << fixed << setprecision(2) << 8.0 * r.headerBytes() / words
+       << " bits per word\n"
+       << "padding ending the bins " << digits - symbols << " of " << digits
+       << " symbols, " << setprecision(1)
+       << 100.0 * (digits - symbols) / digits << "% of the words\n";
+  h.print("blocks/bin", "blocks");
+}
+
+int main(int argc, char *argv[]) {
+  const char *filename = argc > 1 ? argv[1] : "dict.bin";
+  try {
+    DictFile::FileHeader header;
+    if (!DictFile::readHeader(filename, header))
+      throw "Not a dictionary file";
+    DictFileReader file;
+    file.open(filename, header.kind, header.layout);
+
+    uint64_t words = 0;
+    cout << filename << ": ";
+    if (header.kind == DICT_TRIEHASH) {
+      cout << "TrieHashDict\n";
+      trieHash(filename, words);
+    } else if (header.kind == DICT_COMPRESSED3) {
+      cout << "compressed 3 letter dictionary\n";
+      compressed3(filename, words);
+    } else {
+      cout << "dictionary of kind " << header.kind << '\n';
+    }
+
+    cout << '\n'
+         << left << setw(20) << "section" << right << setw(12) << "bytes"
+         << setw(10) << "bits/word" << '\n';
+    uint64_t sections = 0;
+    for (uint32_t i = 0; i < file.numSections(); i++) {
+      const DictFile::SectionEntry &e = file.entry(i);
+      line(sectionName(e.id), e.size, words);
+      sections += e.size;
+    }
+    uint64_t headerBytes = sizeof(DictFile::FileHeader) +
+                           file.numSections() * sizeof(DictFile::SectionEntry);
+    line("file header", headerBytes, words);
+    line("alignment padding", file.fileSize() - sections - headerBytes, words);
+    line("file", file.fileSize(), words);
+    if (words != 0) cout << words << " words\n";
+
+    if (argc > 2) {
+      uint32_t alignment = argc > 3 ? atoi(argv[3]) : 64;
+      file.rewrite(argv[2], alignment);
+      DictFile::FileHeader crunched;
+      DictFile::readHeader(argv[2], crunched);
+      cout << argv[2] << ": " << crunched.fileSize << " bytes with sections on "
+           << alignment << " bytes\n";
+    }
+  } catch (const char *msg) {
+    cerr << msg << '\n';
+    return 1;
+  }
+}
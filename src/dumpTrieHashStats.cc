@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "TrieDict.hh"
+
+using namespace std;
+
+/*
+  Report the shape of a saved dictionary: the load factor of every hash map,
+  how many probes finding each word takes, what a miss costs, and the worst
+  hash maps. Use it to tune the hash function and the load factor from the
+  data instead of guessing.
+
+  usage: dumpTrieHashStats [dict.bin] [worst=20] [queries.txt]
+
+  If compiled with -DTRIEHASH_STATS and given a file of queries (one word
+  per line), it also looks them all up and prints the counters of those
+  real lookups.
+*/
+
+typedef TrieHashDict::BucketStats BucketStats;
+
+void printBucket(const TrieHashDict &dict, const BucketStats &b) {
+  char prefix[3];
+  dict.prefixString(b.prefix, prefix);
+  cout << string(prefix, 3) << setw(8) << b.words << setw(8) << b.slots
+       << setw(8) << fixed << setprecision(3) << b.load() << setw(10)
+       << b.meanHit() << setw(6) << b.maxProbe << setw(10) << b.meanMiss()
+       << '\n';
+}
+
+int main(int argc, char *argv[]) {
+  const char *filename = argc > 1 ? argv[1] : "dict.bin";
+  uint32_t worst = argc > 2 ? atoi(argv[2]) : 20;
+  TrieHashDict dict(filename);
+
+  vector<BucketStats> buckets;
+  dict.forEachBucket(
+      [&buckets](const BucketStats &b) { buckets.push_back(b); });
+  uint64_t words = 0, slots = 0, hit = 0, miss = 0;
+  uint32_t loadHist[11] = {0};  // load factor in tenths
+  for (const BucketStats &b : buckets) {
+    words += b.words;
+    slots += b.slots;
+    hit += b.hitProbes;
+    miss += b.missProbes;
+    loadHist[uint32_t(b.load() * 10)]++;
+  }
+  cout << filename << ": " << words << " words in " << buckets.size()
+       << " hash maps, " << slots << " slots\n"
+       << "load factor " << fixed << setprecision(3) << double(words) / slots
+       << ", mean probes per hit " << double(hit) / words
+       << ", per miss " << double(miss) / slots << "\n\nload factor\n";
+  for (uint32_t i = 0; i <= 10; i++)
+    if (loadHist[i] != 0)
+      cout << setw(4) << setprecision(1) << i / 10.0 << setw(8) << loadHist[i]
+           << '\n';
+
+  cout << "\nworst hash maps by mean probes per hit\n"
+       << "pre   words   slots    load  mean hit   max mean miss\n";
+  sort(buckets.begin(), buckets.end(),
+       [](const BucketStats &a, const BucketStats &b) {
+         return a.meanHit() != b.meanHit() ? a.meanHit() > b.meanHit()
+                                           : a.maxProbe > b.maxProbe;
+       });
+  for (uint32_t i = 0; i < worst && i < buckets.size(); i++)
+    printBucket(dict, buckets[i]);
+
+#ifdef TRIEHASH_STATS
+  if (argc > 3) {
+    ifstream f(argv[3]);
+    string w;
+    uint32_t id, found = 0;
+    while (f >> w) found += dict.get(w.data(), w.size(), id);
+    cout << "\n" << found << " of the queries in " << argv[3] << " found\n"
+         << dict.getStats();
+  }
+#endif
+}
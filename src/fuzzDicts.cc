@@ -0,0 +1,739 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AsyncLoader.hh"
+#include "Bitstream.hh"
+#include "Compressed3letterTrie.hh"
+#include "CompressedDict1.hh"
+#include "DictMerge.hh"
+#include "LookupCache.hh"
+#include "MultiDict.hh"
+#include "TrieDict.hh"
+
+using namespace std;
+
+/*
+  Differential tests of every engine against std::set. Each round makes a
+  random set of words (short ones, long ones, words that are prefixes of
+  others, all from a few letters or from all 26) and builds from it:
+
+    TrieHashDict      by add(), saved with and without a filter and opened
+                      from the file, from memory and by an AsyncLoader with
+                      small chunks, and by add() into a buffer too small,
+                      checking the words before the one refused
+    layout            prioritize() with a random hot table, then relayout()
+                      of the loaded file, saved and opened again
+    LookupCache       a small cache in front, queried with repeats
+    ByteAlphabet      the same words with each letter made some other byte,
+                      UTF-8 and punctuation included, built by load()
+    MultiDict         the words shared out among 1 to 4 lists
+    merge             two overlapping halves merged by union, intersection
+                      and difference, as TrieHashDicts and compressed
+    Compressed3       CompressedDict written and read by CompressedDictReader,
+                      and loaded into a TrieHashDict with loadBins
+    CompressedDict1   planned with a random weight, fixed or adaptive
+    Bitstream         random values of 1 to 64 bits written and read back
+
+  Every word of the set and as many near misses are looked up, and each
+  lookup, id, rank, select, prefix range and decoded word must be what the
+  set says. The first difference throws, naming the round.
+
+    g++ -std=c++20 -g -O1 -fsanitize=address,undefined -o fuzzDicts \
+        src/fuzzDicts.cc
+    ./fuzzDicts [rounds=1000] [seed=1]
+
+  runs rounds of random sets, round r from seed + r so a failing round can
+  be run alone. Built with -DFUZZ_LIBFUZZER and -fsanitize=fuzzer (clang),
+  libFuzzer's input drives the same choices instead:
+
+    clang++ -std=c++20 -g -O1 -fsanitize=fuzzer,address,undefined \
+        -DFUZZ_LIBFUZZER -o fuzzDicts src/fuzzDicts.cc
+    ./fuzzDicts corpus/
+
+  The dictionaries go through files, in /tmp unless TMPDIR says otherwise.
+*/
+
+// the random choices, from a seeded generator or the bytes of a fuzz input
+class Choices {
+ private:
+  mt19937_64 rng;
+  const uint8_t *data;
+  size_t size;
+
+ public:
+  Choices(uint64_t seed) : rng(seed), data(nullptr), size(0) {}
+  Choices(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+  // 0 to n - 1; a fuzz input gives 0 once it runs out
+  uint32_t below(uint32_t n) {
+    if (data == nullptr) return rng() % n;
+    uint64_t v = 0;
+    for (uint64_t range = 1; range < n && size > 0; range <<= 8, size--)
+      v = v << 8 | *data++;
+    return v % n;
+  }
+  bool oneIn(uint32_t n) { return below(n) == 0; }
+};
+
+struct Failure {
+  string what;
+};
+#define CHECK(cond, what)                                             \
+  do {                                                                \
+    if (!(cond)) throw Failure{string(what) + " (line " +             \
+                               to_string(__LINE__) + ")"};            \
+  } while (0)
+
+static string tempName(const char name[]) {
+  const char *dir = getenv("TMPDIR");
+  return string(dir != nullptr ? dir : "/tmp") + "/fuzzDicts." +
+         to_string(getpid()) + "." + name;
+}
+
+// the limits of a TrieHashDict and the compressed formats
+static constexpr uint32_t MAX_LEN = TrieHashDict::MAX_WORD;
+
+static string randomWord(Choices &c, uint32_t letters) {
+  uint32_t len;
+  switch (c.below(8)) {
+    case 0:
+      len = 1 + c.below(3);  // around the 3 letter prefix
+      break;
+    case 1:
+      len = MAX_LEN - c.below(4);  // the longest there are
+      break;
+    case 2:
+      len = 1 + c.below(40);
+      break;
+    default:
+      len = 3 + c.below(8);
+  }
+  string w(len, 'a');
+  for (char &x : w) x = 'a' + c.below(letters);
+  return w;
+}
+
+static set<string> randomWords(Choices &c) {
+  set<string> words;
+  uint32_t letters = c.oneIn(2) ? 2 + c.below(3) : 26;
+  uint32_t n = c.oneIn(8) ? c.below(4) : c.below(c.oneIn(4) ? 3000 : 300);
+  for (uint32_t i = 0; i < n; i++) {
+    if (!words.empty() && c.oneIn(4)) {
+      // a word extending or cutting one already there
+      auto it = words.lower_bound(string(1, 'a' + c.below(letters)));
+      if (it == words.end()) it = words.begin();
+      string w = *it;
+      if (c.oneIn(2) && w.size() < MAX_LEN)
+        w += char('a' + c.below(letters));
+      else if (w.size() > 1)
+        w.resize(1 + c.below(w.size() - 1));
+      words.insert(w);
+    } else {
+      words.insert(randomWord(c, letters));
+    }
+  }
+  return words;
+}
+
+// words near the set: changed, cut, extended, or with a byte not a letter
+static vector<string> nearMisses(Choices &c, const set<string> &words) {
+  vector<string> misses;
+  vector<string> all(words.begin(), words.end());
+  for (uint32_t i = 0; i < 200 + all.size(); i++) {
+    string w = all.empty() ? randomWord(c, 26) : all[c.below(all.size())];
+    switch (c.below(6)) {
+      case 0:
+        w[c.below(w.size())] = 'a' + c.below(26);
+        break;
+      case 1:
+        w.resize(c.below(w.size() + 1));
+        break;
+      case 2:
+        w += char('a' + c.below(26));
+        break;
+      case 3:  // anything at all, high bit, upper case or a nul
+        w[c.below(w.size())] = char(c.below(256));
+        break;
+      case 4:
+        w.append(c.below(300), 'a' + c.below(26));
+        break;
+      default:
+        w = randomWord(c, 26);
+    }
+    if (!w.empty()) misses.push_back(w);
+  }
+  return misses;
+}
+
+// every byte of w has a code in a
+template <typename Alphabet>
+bool inAlphabet(const Alphabet &a, const string &w) {
+  for (char x : w)
+    if (a.index(x) < 0) return false;
+  return true;
+}
+
+// words in the order of their codes, which is the order of the ids
+template <typename Alphabet>
+struct ByCodes {
+  Alphabet alphabet;
+  bool operator()(const string &a, const string &b) const {
+    return lexicographical_compare(
+        a.begin(), a.end(), b.begin(), b.end(),
+        [this](char x, char y) {
+          return alphabet.index(x) < alphabet.index(y);
+        });
+  }
+};
+
+static void writeWords(const string &filename, const set<string> &words) {
+  ofstream f(filename);
+  for (const string &w : words) f << w << '\n';
+  if (!f) throw "Could not write the word list";
+}
+
+// what a TrieHashDict should answer for every query, words a set in the
+// order of the dictionary's codes
+template <typename Dict, typename Words>
+void checkTrieHashDict(const Dict &d, const Words &words,
+                       const vector<string> &misses) {
+  CHECK(d.numWords() == words.size(), "numWords");
+  uint32_t id = 1;
+  char buf[Dict::MAX_WORD];
+  for (const string &w : words) {
+    uint32_t got = 0;
+    CHECK(d.get(w.data(), w.size(), got) && got == id, "get of " + w);
+    CHECK(d.rank(w.data(), w.size()) == id - 1, "rank of " + w);
+    uint32_t len = d.select(id, buf);
+    CHECK(string(buf, len) == w, "select of " + to_string(id));
+    id++;
+  }
+  CHECK(d.select(0, buf) == 0 && d.select(id, buf) == 0, "select of no id");
+  vector<string> each;
+  d.forEachWord([&each](const char word[], uint32_t len) {
+    each.emplace_back(word, len);
+  });
+  sort(each.begin(), each.end(), words.key_comp());
+  CHECK(each == vector<string>(words.begin(), words.end()), "forEachWord");
+
+  vector<const char *> queries;
+  vector<uint32_t> lens, expect;
+  for (const string &w : misses) {
+    auto at = words.lower_bound(w);
+    bool in = at != words.end() && *at == w;
+    uint32_t got = 0;
+    CHECK(d.get(w.data(), w.size(), got) == in, "get of miss " + w);
+    queries.push_back(w.data());
+    lens.push_back(w.size());
+    expect.push_back(in ? distance(words.begin(), at) + 1 : 0);
+    if (!inAlphabet(d.getAlphabet(), w) || w.size() > Dict::MAX_WORD)
+      continue;
+    uint32_t r = distance(words.begin(), at);
+    CHECK(d.rank(w.data(), w.size()) == r, "rank of miss " + w);
+    // the ids of the words starting with a prefix of w
+    string prefix = w.substr(0, min<size_t>(w.size(), 1 + w.size() % 5));
+    auto range = d.prefixToIdRange(prefix.data(), prefix.size());
+    uint32_t first = distance(words.begin(), words.lower_bound(prefix)) + 1,
+             last = first;
+    for (auto it = words.lower_bound(prefix);
+         it != words.end() && it->compare(0, prefix.size(), prefix) == 0; it++)
+      last++;
+    CHECK(range.first == first && range.second == last,
+          "prefixToIdRange of " + prefix);
+  }
+  for (const string &w : words) {
+    queries.push_back(w.data());
+    lens.push_back(w.size());
+    expect.push_back(distance(words.begin(), words.find(w)) + 1);
+  }
+  vector<uint32_t> ids(queries.size(), ~0U);
+  uint32_t found = d.getBatch(queries.data(), lens.data(), queries.size(),
+                              ids.data());
+  CHECK(ids == expect, "getBatch ids");
+  CHECK(found == queries.size() - count(expect.begin(), expect.end(), 0U),
+        "getBatch count");
+#ifdef TRIEHASH_COROUTINES
+  CoroScheduler s;
+  vector<uint32_t> async(queries.size(), ~0U);
+  auto lookup = [&](uint32_t i) -> CoroTask<> {
+    async[i] = co_await d.getAsync(queries[i], lens[i]);
+  };
+  for (uint32_t i = 0; i < queries.size(); i++) s.spawn(lookup(i));
+  s.run();
+  CHECK(async == expect, "getAsync ids");
+#endif
+}
+
+// a limit of the format, not a bug
+static bool isLimit(const char msg[]) {
+  return strcmp(msg, "TrieHashDict capacity exceeded") == 0 ||
+         strcmp(msg, "hash map text too big for Offset") == 0 ||
+         strcmp(msg, "bucket exceeds MaxBucket") == 0;
+}
+
+// the id of w in words, 0 if it is not there
+static uint32_t idOf(const vector<string> &all, const string &w) {
+  auto at = lower_bound(all.begin(), all.end(), w);
+  return at != all.end() && *at == w ? at - all.begin() + 1 : 0;
+}
+
+// a file read in chunks as small as 64 bytes, looked up while it arrives
+static void fuzzAsyncLoader(Choices &c, const string &file,
+                            const set<string> &words,
+                            const vector<string> &misses) {
+  uint32_t chunk = 64 << c.below(10), depth = 1 + c.below(32),
+           threads = 1 + c.below(4);
+  bool uring = c.oneIn(2);
+  AsyncLoader l(file.c_str(), chunk, depth, threads, uring);
+  TrieHashDict d(l);
+  vector<string> all(words.begin(), words.end());
+  auto lookup = [&d](const string &w, uint32_t &id) {
+    TrieHashDict::LookupResult r;
+    while ((r = d.tryGet(w.data(), w.size(), id)) == TrieHashDict::NOT_LOADED)
+      this_thread::yield();  // its hash map has been asked for
+    return r == TrieHashDict::FOUND;
+  };
+  for (uint32_t i = 0; i < all.size(); i++) {
+    uint32_t id = 0;
+    CHECK(lookup(all[i], id) && id == i + 1, "tryGet of " + all[i]);
+  }
+  for (const string &w : misses) {
+    uint32_t id = 0, want = idOf(all, w);
+    CHECK(lookup(w, id) == (want != 0), "tryGet of miss " + w);
+  }
+  l.wait();
+  checkTrieHashDict(d, words, misses);
+}
+
+// words and misses again and again through a cache of a few entries
+static void fuzzLookupCache(Choices &c, const TrieHashDict &d,
+                            const set<string> &words,
+                            const vector<string> &misses) {
+  LookupCache<TrieHashDict> cache(d, 1 << c.below(7));
+  vector<string> all(words.begin(), words.end());
+  vector<const string *> queries;
+  for (uint32_t i = 0; i < 2 * (all.size() + misses.size()); i++) {
+    uint32_t k = c.below(all.size() + misses.size());
+    queries.push_back(k < all.size() ? &all[k] : &misses[k - all.size()]);
+  }
+  vector<const char *> batch;
+  vector<uint32_t> lens, expect;
+  for (const string *w : queries) {
+    uint32_t id = 0, want = idOf(all, *w);
+    CHECK(cache.get(w->data(), w->size(), id) == (want != 0) &&
+              (want == 0 || id == want),
+          "LookupCache get of " + *w);
+    batch.push_back(w->data());
+    lens.push_back(w->size());
+    expect.push_back(want);
+  }
+  if (c.oneIn(2)) cache.clear();
+  vector<uint32_t> ids(batch.size(), ~0U);
+  uint32_t found =
+      cache.getBatch(batch.data(), lens.data(), batch.size(), ids.data());
+  CHECK(ids == expect, "LookupCache getBatch ids");
+  CHECK(found == batch.size() - count(expect.begin(), expect.end(), 0U),
+        "LookupCache getBatch count");
+  const LookupStats &stats = cache.getStats();
+  CHECK(stats.cacheHits + stats.cacheMisses <= 2 * queries.size(),
+        "LookupCache stats");
+}
+
+// prioritize() the built dictionary, then relayout() a loaded one
+static void fuzzLayout(Choices &c, TrieHashDict &built,
+                       const set<string> &words,
+                       const vector<string> &misses) {
+  uint32_t salt = c.below(1 << 16);
+  uint32_t hotEntries = c.oneIn(3) ? 0 : 1 << c.below(9);
+  built.prioritize(
+      [salt](const char word[], uint32_t len) -> uint64_t {
+        return (WordHash::hash(word, len) ^ salt) % 5;  // some weigh 0
+      },
+      hotEntries);
+  checkTrieHashDict(built, words, misses);
+
+  string file = tempName("prioritized.bin"), out = tempName("relaid.bin");
+  built.save(file.c_str());
+  TrieHashDict loaded(file.c_str());
+  checkTrieHashDict(loaded, words, misses);
+  vector<uint64_t> weight(loaded.numHashMaps());
+  for (uint64_t &w : weight) w = c.below(4);
+  loaded.relayout(weight);
+  checkTrieHashDict(loaded, words, misses);
+  loaded.save(out.c_str());
+  TrieHashDict relaid(out.c_str());
+  CHECK(relaid.verify(), "verify after relayout");
+  checkTrieHashDict(relaid, words, misses);
+  unlink(file.c_str());
+  unlink(out.c_str());
+}
+
+static void fuzzTrieHashDict(Choices &c, const set<string> &words,
+                             const vector<string> &misses) {
+  if (c.oneIn(4)) {
+    // a build buffer too small is reported, not overrun, and the words
+    // added before the one refused can all still be looked up
+    TrieHashDict small(1 + c.below(words.size() + 1));
+    set<string> added;
+    for (const string &w : words) {
+      try {
+        small.add(w.data(), w.size());
+      } catch (const char *msg) {
+        if (!isLimit(msg)) throw;
+        break;
+      }
+      added.insert(w);
+    }
+    checkTrieHashDict(small, added, misses);
+  }
+  uint64_t letters = 0;
+  for (const string &w : words) letters += w.size();
+  TrieHashDict built(uint64_t(words.size()), letters);
+  for (const string &w : words) built.add(w.data(), w.size());
+  checkTrieHashDict(built, words, misses);
+
+  string file = tempName("triehash.bin");
+  uint32_t filterBits = c.oneIn(2) ? 0 : 1 + c.below(16);
+  built.save(file.c_str(), filterBits);
+  TrieHashDict loaded(file.c_str());
+  CHECK(loaded.verify(), "verify after save");
+  checkTrieHashDict(loaded, words, misses);
+
+  // and from memory, at an offset the file never had
+  ifstream f(file, ios::binary);
+  string image((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+  vector<uint64_t> buf(image.size() / 8 + 1);
+  memcpy(buf.data(), image.data(), image.size());
+  TrieHashDict inMemory((const char *)buf.data(), image.size());
+  checkTrieHashDict(inMemory, words, misses);
+  fuzzAsyncLoader(c, file, words, misses);
+  unlink(file.c_str());
+
+  fuzzLookupCache(c, built, words, misses);
+  fuzzLayout(c, built, words, misses);
+}
+
+// the same words in other bytes, so the codes are not the letters
+static void fuzzByteAlphabet(Choices &c, const set<string> &words,
+                             const vector<string> &misses) {
+  using Dict = BasicTrieHashDict<ByteAlphabet<>>;
+  // 26 different bytes above ' ' for the letters
+  vector<char> bytes;
+  for (uint32_t b = ' ' + 1; b < 256; b++) bytes.push_back(char(b));
+  for (uint32_t k = 0; k < 26; k++)
+    swap(bytes[k], bytes[k + c.below(bytes.size() - k)]);
+  auto remap = [&bytes](string w) {
+    for (char &x : w)
+      if (x >= 'a' && x <= 'z') x = bytes[x - 'a'];
+    return w;
+  };
+  set<string> mapped;
+  uint64_t letters = 0;
+  for (const string &w : words) {
+    mapped.insert(remap(w));
+    letters += w.size();
+  }
+  vector<string> mappedMisses;
+  for (const string &w : misses) mappedMisses.push_back(remap(w));
+
+  string txt = tempName("bytes.txt"), bin = tempName("bytes.bin");
+  writeWords(txt, mapped);
+  Dict built(uint64_t(words.size()), letters);
+  built.load(txt.c_str());
+  set<string, ByCodes<ByteAlphabet<>>> ordered(
+      mapped.begin(), mapped.end(),
+      ByCodes<ByteAlphabet<>>{built.getAlphabet()});
+  checkTrieHashDict(built, ordered, mappedMisses);
+  built.save(bin.c_str());
+  Dict loaded(bin.c_str());
+  CHECK(loaded.verify(), "ByteAlphabet verify");
+  checkTrieHashDict(loaded, ordered, mappedMisses);
+  unlink(txt.c_str());
+  unlink(bin.c_str());
+}
+
+// each word in a random nonempty subset of 1 to 4 lists
+static void fuzzMultiDict(Choices &c, const set<string> &words,
+                          const vector<string> &misses) {
+  uint32_t n = 1 + c.below(4);
+  vector<set<string>> lists(n);
+  vector<uint64_t> masks;
+  for (const string &w : words) {
+    uint64_t m = 1 + c.below((1 << n) - 1);
+    for (uint32_t k = 0; k < n; k++)
+      if ((m >> k & 1) != 0) lists[k].insert(w);
+    masks.push_back(m);
+  }
+  vector<string> names, files;
+  for (uint32_t k = 0; k < n; k++) {
+    names.push_back("list" + to_string(k));
+    files.push_back(tempName(names[k].c_str()));
+    writeWords(files[k], lists[k]);
+  }
+  vector<string> all(words.begin(), words.end());
+  auto check = [&](const MultiDict &m) {
+    CHECK(m.numDictionaries() == n && m.name(n - 1) == names[n - 1] &&
+              m.find(names[0]) == 0 && m.find("none") == -1,
+          "MultiDict names");
+    checkTrieHashDict(m.getDict(), words, misses);
+    for (uint32_t i = 0; i < all.size(); i++) {
+      uint32_t id = 0;
+      CHECK(m.which(all[i].data(), all[i].size(), id) == masks[i] &&
+                id == i + 1,
+            "MultiDict which of " + all[i]);
+    }
+    for (const string &w : misses) {
+      uint32_t want = idOf(all, w);
+      CHECK(m.which(w.data(), w.size()) == (want == 0 ? 0 : masks[want - 1]),
+            "MultiDict which of miss " + w);
+    }
+  };
+  MultiDict built(names, files);
+  check(built);
+  string bin = tempName("multi.bin");
+  built.save(bin.c_str());
+  MultiDict loaded(bin.c_str());
+  check(loaded);
+  for (const string &f : files) unlink(f.c_str());
+  unlink(bin.c_str());
+}
+
+// the words of a compressed 3 letter dictionary, decoded bin by bin
+template <typename Reader>
+void checkCompressed3(const Reader &r, const set<string> &stored,
+                      const string &what) {
+  CHECK(r.verify(), what + " verify");
+  CHECK(r.numWords() == stored.size(), what + " numWords");
+  auto next = stored.begin();
+  for (uint32_t bin = 0; bin < r.FIRST_N; bin++) {
+    string prefix = {char('a' + bin / 676), char('a' + bin / 26 % 26),
+                     char('a' + bin % 26)};
+    r.forEachSuffix(bin, [&](const uint8_t codes[], uint32_t len) {
+      string w = prefix;
+      for (uint32_t i = 0; i < len; i++) w += char('a' + codes[i]);
+      CHECK(next != stored.end() && *next == w, what + " decode " + w);
+      next++;
+    });
+  }
+  CHECK(next == stored.end(), what + " decode count");
+}
+
+// two overlapping halves of the words, merged every way
+static void fuzzMerge(Choices &c, const set<string> &words,
+                      const vector<string> &misses) {
+  set<string> a, b;
+  uint64_t lettersA = 0, lettersB = 0;
+  for (const string &w : words) {
+    uint32_t side = c.below(3);
+    if (side != 1) a.insert(w), lettersA += w.size();
+    if (side != 0) b.insert(w), lettersB += w.size();
+  }
+  TrieHashDict da(uint64_t(a.size()), lettersA),
+      db(uint64_t(b.size()), lettersB);
+  for (const string &w : a) da.add(w.data(), w.size());
+  for (const string &w : b) db.add(w.data(), w.size());
+
+  string txtA = tempName("a.txt"), txtB = tempName("b.txt"),
+         binA = tempName("a3.bin"), binB = tempName("b3.bin"),
+         out = tempName("merged3.bin");
+  writeWords(txtA, a);
+  writeWords(txtB, b);
+  CompressedDict<>(txtA.c_str()).writeCompressed(binA.c_str());
+  CompressedDict<>(txtB.c_str()).writeCompressed(binB.c_str());
+  CompressedDictReader<> ra(binA.c_str()), rb(binB.c_str());
+
+  for (SetOp op : {SET_UNION, SET_INTERSECTION, SET_DIFFERENCE}) {
+    set<string> want, stored;
+    auto to = inserter(want, want.end());
+    if (op == SET_UNION)
+      set_union(a.begin(), a.end(), b.begin(), b.end(), to);
+    else if (op == SET_INTERSECTION)
+      set_intersection(a.begin(), a.end(), b.begin(), b.end(), to);
+    else
+      set_difference(a.begin(), a.end(), b.begin(), b.end(), to);
+    string what = "merge " + to_string(op);
+    TrieHashDict merged(uint64_t(a.size() + b.size()), lettersA + lettersB);
+    mergeTrieHashDicts(da, db, op, merged);
+    checkTrieHashDict(merged, want, misses);
+
+    for (const string &w : want)
+      if (w.size() >= 3) stored.insert(w);  // as a compressed one keeps
+    CompressedDict<> compressed(ra.getAlphabet());
+    mergeCompressedDicts(ra, rb, op, compressed);
+    compressed.writeCompressed(out.c_str());
+    checkCompressed3(CompressedDictReader<>(out.c_str()), stored, what);
+  }
+  for (const string &f : {txtA, txtB, binA, binB, out}) unlink(f.c_str());
+}
+
+static void fuzzCompressed3(const set<string> &words,
+                            const vector<string> &misses) {
+  set<string> stored;  // words shorter than the prefix are not
+  for (const string &w : words)
+    if (w.size() >= 3) stored.insert(w);
+  string txt = tempName("words.txt"), bin = tempName("dict3.bin");
+  writeWords(txt, words);
+  {
+    CompressedDict<> dict(txt.c_str());
+    dict.writeCompressed(bin.c_str());
+  }
+  CompressedDictReader<> r(bin.c_str());
+  checkCompressed3(r, stored, "Compressed3");
+
+  vector<const char *> queries;
+  vector<uint32_t> lens, expect;
+  auto query = [&](const string &w) {
+    auto at = stored.find(w);
+    uint32_t want = at == stored.end() ? 0 : distance(stored.begin(), at) + 1;
+    uint32_t id = 0;
+    CHECK(r.get(w.data(), w.size(), id) == (want != 0) &&
+              (want == 0 || id == want),
+          "Compressed3 get of " + w);
+    queries.push_back(w.data());
+    lens.push_back(w.size());
+    expect.push_back(want);
+  };
+  for (const string &w : words) query(w);
+  for (const string &w : misses) query(w);
+  vector<uint32_t> ids(queries.size(), ~0U);
+  r.getBatch(queries.data(), lens.data(), queries.size(), ids.data());
+  CHECK(ids == expect, "Compressed3 getBatch ids");
+
+  TrieHashDict loaded;
+  loaded.loadBins(r, 1 + queries.size() % 3);
+  checkTrieHashDict(loaded, stored, misses);
+  bool refused = false;
+  try {
+    loaded.add("zzzzzz", 6);  // the image is sized exactly
+  } catch (const char *) {
+    refused = true;
+  }
+  CHECK(refused, "add after loadBins");
+  checkTrieHashDict(loaded, stored, misses);
+  unlink(txt.c_str());
+  unlink(bin.c_str());
+}
+
+static void fuzzCompressedDict1(Choices &c, const set<string> &words,
+                                const vector<string> &misses) {
+  string txt = tempName("words1.txt"), bin = tempName("dict1.bin");
+  writeWords(txt, words);
+  CompressedDict1<> dict(txt.c_str());
+  CHECK(dict.numWords() == words.size(), "CompressedDict1 numWords");
+  double weight = c.oneIn(4) ? 0 : 1 << c.below(16);
+  dict.plan(weight, !c.oneIn(3));
+  dict.writeCompressed(bin.c_str());
+  CompressedDict1Reader<> r(bin.c_str());
+  uint64_t work = 0;
+  for (const string &w : words)
+    CHECK(r.get(w.data(), w.size(), work), "CompressedDict1 get of " + w);
+  for (const string &w : misses)
+    CHECK(r.get(w.data(), w.size(), work) == (words.count(w) == 1),
+          "CompressedDict1 get of miss " + w);
+  unlink(txt.c_str());
+  unlink(bin.c_str());
+}
+
+// values of 1 to 64 bits written one after another, read back
+static void fuzzBitstream(Choices &c) {
+  uint32_t n = c.below(200);
+  vector<uint64_t> values(n);
+  vector<uint32_t> lens(n);
+  uint64_t bits = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    lens[i] = c.oneIn(4) ? 64 - c.below(3) : 1 + c.below(64);
+    uint64_t v = uint64_t(c.below(1 << 16)) << 48 | uint64_t(c.below(1 << 16))
+                 << 32 | uint64_t(c.below(1 << 16)) << 16 | c.below(1 << 16);
+    values[i] = lens[i] == 64 ? v : v & ((1ULL << lens[i]) - 1);
+    bits += lens[i];
+  }
+  vector<uint64_t> mem(bits / 64 + 2, ~0ULL);
+  Bitstream w(mem.data());
+  for (uint32_t i = 0; i < n; i++) w.write(values[i], lens[i]);
+  CHECK(w.length() == bits / 64, "Bitstream length");
+  uint64_t first = mem[0];
+  Bitstream r(mem.data());  // which starts the buffer afresh
+  mem[0] = first;
+  BitIterator it(mem.data(), 0);
+  for (uint32_t i = 0; i < n; i++) {
+    CHECK(r.read(lens[i]) == values[i], "Bitstream read");
+    CHECK(it.read(lens[i]) == values[i], "BitIterator read");
+  }
+  // replace each value by its complement in place, leaving the others
+  BitIterator at(mem.data(), 0);
+  for (uint32_t i = 0; i < n; i++) {
+    uint64_t mask = lens[i] == 64 ? ~0ULL : (1ULL << lens[i]) - 1;
+    if (i % 2 == 0)
+      at.replace(~values[i] & mask, lens[i]);
+    else
+      at.read(lens[i]);
+  }
+  BitIterator back(mem.data(), 0);
+  for (uint32_t i = 0; i < n; i++) {
+    uint64_t mask = lens[i] == 64 ? ~0ULL : (1ULL << lens[i]) - 1;
+    uint64_t want = i % 2 == 0 ? ~values[i] & mask : values[i];
+    CHECK(back.read(lens[i]) == want, "BitIterator replace");
+  }
+}
+
+static void fuzzOnce(Choices &c) {
+  set<string> words = randomWords(c);
+  vector<string> misses = nearMisses(c, words);
+  // a random set can be beyond what a TrieHashDict holds
+  for (auto fuzz : {fuzzTrieHashDict, fuzzByteAlphabet, fuzzMultiDict,
+                    fuzzMerge}) {
+    try {
+      fuzz(c, words, misses);
+    } catch (const char *msg) {
+      if (!isLimit(msg)) throw;
+    }
+  }
+  fuzzCompressed3(words, misses);
+  fuzzCompressedDict1(c, words, misses);
+  fuzzBitstream(c);
+}
+
+#ifdef FUZZ_LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  Choices c(data, size);
+  try {
+    fuzzOnce(c);
+  } catch (const Failure &f) {
+    cerr << f.what << '\n';
+    abort();
+  } catch (const char *msg) {
+    cerr << msg << '\n';
+    abort();
+  }
+  return 0;
+}
+#else
+int main(int argc, char *argv[]) {
+  uint32_t rounds = argc > 1 ? atoi(argv[1]) : 1000;
+  uint64_t seed = argc > 2 ? atoll(argv[2]) : 1;
+  for (uint32_t r = 0; r < rounds; r++) {
+    Choices c(seed + r);
+    try {
+      fuzzOnce(c);
+    } catch (const Failure &f) {
+      cerr << "seed " << seed + r << ": " << f.what << '\n';
+      return 1;
+    } catch (const char *msg) {
+      cerr << "seed " << seed + r << ": " << msg << '\n';
+      return 1;
+    }
+  }
+  cout << rounds << " rounds from seed " << seed << " passed\n";
+}
+#endif
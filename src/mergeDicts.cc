@@ -0,0 +1,74 @@
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "Benchmark.hh"
+#include "DictMerge.hh"
+
+using namespace std;
+
+/*
+  Union, intersection or difference of two saved dictionaries of the same
+  kind, either TrieHashDict images or compressed 3 letter ones, written to
+  a new file of that kind without going back to any text (see DictMerge.hh).
+
+  usage: mergeDicts union|intersect|diff a.bin b.bin out.bin
+*/
+
+int main(int argc, char *argv[]) {
+  if (argc != 5) {
+    cerr << "usage: mergeDicts union|intersect|diff a.bin b.bin out.bin\n";
+    return 1;
+  }
+  SetOp op;
+  if (strcmp(argv[1], "union") == 0)
+    op = SET_UNION;
+  else if (strcmp(argv[1], "intersect") == 0)
+    op = SET_INTERSECTION;
+  else if (strcmp(argv[1], "diff") == 0)
+    op = SET_DIFFERENCE;
+  else {
+    cerr << "unknown operation " << argv[1] << '\n';
+    return 1;
+  }
+  try {
+    uint32_t kind = DictFile::kindOf(argv[2]);
+    if (kind != DictFile::kindOf(argv[3]))
+      throw "the dictionaries are of different kinds";
+    uint64_t words = 0;
+    double ns;
+    if (kind == DICT_TRIEHASH) {
+      TrieHashDict a(argv[2]), b(argv[3]);
+      // the result has at most the words and the text of both
+      uint64_t most = uint64_t(a.numWords()) + b.numWords(),
+               letters = a.footprint().text + b.footprint().text;
+      ns = Benchmark::time(
+          [&] {
+            TrieHashDict out(most, letters);
+            mergeTrieHashDicts(a, b, op, out);
+            out.save(argv[4]);
+            return uint64_t(out.numWords());
+          },
+          words);
+    } else if (kind == DICT_COMPRESSED3) {
+      CompressedDictReader<> a(argv[2]), b(argv[3]);
+      ns = Benchmark::time(
+          [&] {
+            CompressedDict<> out(a.getAlphabet());
+            mergeCompressedDicts(a, b, op, out);
+            out.writeCompressed(argv[4]);
+            return uint64_t(0);
+          },
+          words);
+    } else {
+      throw "mergeDicts handles TrieHashDict and compressed 3 letter files";
+    }
+    cerr << argv[4] << ": " << argv[1] << " written in " << fixed
+         << setprecision(3) << ns / 1e6 << " ms";
+    if (words != 0) cerr << ", " << words << " words";
+    cerr << '\n';
+  } catch (const char *msg) {
+    cerr << msg << '\n';
+    return 1;
+  }
+}
@@ -0,0 +1,79 @@
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Benchmark.hh"
+#include "Compressed3letterTrie.hh"
+#include "TrieDict.hh"
+
+using namespace std;
+
+/*
+  Open a compressed 3 letter dictionary (written by Compressed3letterTrie)
+  as a TrieHashDict by decoding its bins in parallel, and report how long
+  that takes with 1, 2, 4, ... threads. The compressed file is the format
+  to store and ship, the TrieHashDict the one to serve lookups from.
+
+  usage: openCompressedDict [dict3.bin] [dict.txt] [out.bin]
+
+  Every word of at least 3 letters in dict.txt is looked up to check the
+  decoded dictionary, and given out.bin the image is saved there.
+*/
+
+int main(int argc, char *argv[]) {
+  const char *compressed = argc > 1 ? argv[1] : "dict3.bin";
+  const char *words = argc > 2 ? argv[2] : "dict.txt";
+  try {
+    uint64_t check;
+    CompressedDictReader<> *reader = nullptr;
+    double ns = Benchmark::time(
+        [&reader, compressed] {
+          reader = new CompressedDictReader<>(compressed);
+          return uint64_t(0);
+        },
+        check);
+    cout << compressed << ": opened in " << fixed << setprecision(3)
+         << ns / 1e6 << " ms\n";
+
+    uint32_t cores = max(1U, thread::hardware_concurrency());
+    for (uint32_t t = 1;; t = min(t * 2, cores)) {
+      TrieHashDict dict(uint32_t(0));  // loadBins sizes the image
+      ns = Benchmark::time(
+          [&dict, reader, t] {
+            dict.loadBins(*reader, t);
+            return uint64_t(dict.numWords());
+          },
+          check);
+      cout << setw(3) << t << " threads  " << check << " words decoded in "
+           << ns / 1e6 << " ms\n";
+      if (t == cores) break;
+    }
+
+    TrieHashDict dict(uint32_t(0));  // loadBins sizes the image
+    dict.loadBins(*reader);
+    ifstream f(words);
+    string w;
+    uint32_t found = 0, missing = 0, id, last = 0, outOfOrder = 0;
+    while (f >> w) {
+      if (w.size() < 3) continue;
+      if (!dict.get(w.data(), w.size(), id)) {
+        missing++;
+        continue;
+      }
+      found++;
+      outOfOrder += id != last + 1;
+      last = id;
+    }
+    cout << found << " words of " << words << " found, " << missing
+         << " missing, " << outOfOrder << " ids out of order\n";
+    if (argc > 3) dict.save(argv[3]);
+    delete reader;
+    return missing == 0 && outOfOrder == 0 ? 0 : 1;
+  } catch (const char *msg) {
+    cerr << msg << '\n';
+    return 1;
+  }
+}
@@ -1,16 +1,13 @@
 #include <cstdint>
 #include <fstream>
 #include <iostream>
-using namespace std;
 
-constexpr uint64_t base = 27;
-constexpr uint64_t base2 = base * base;
-constexpr uint64_t base4 = base2 * base2;
-constexpr uint64_t base8 = base4 * base4;
+#include "Alphabet.hh"
+#include "PackedSymbols.hh"
+using namespace std;
 
-constexpr uint64_t baseto13 = base8 * base4 * base;
-constexpr uint8_t END = base - 1;
-constexpr uint8_t END2 = base - 2;
+using Packing = SymbolPacking<Alpha26::size>;
+constexpr uint8_t END = Packing::END;
 
 int main() {
   ifstream bin("words.bin", ios::binary);
@@ -21,14 +18,12 @@ int main() {
   uint64_t* p = new uint64_t[(bytes + 7) / 8];
   bin.read((char*)p, bytes);
 
+  uint8_t digits[Packing::perWord];
   for (uint32_t i = 0; i < size; i++) {
-    uint64_t current = p[i];
-    for (int j = 0; j < 12; j++) {
-      uint8_t c = current % base;
-      cout << (c < END ? (char)(c + 'a') : ' ');
-      current /= base;
+    Packing::unpack(p[i], digits);
+    for (uint32_t j = 0; j < Packing::perWord; j++) {
+      uint8_t c = digits[j];
+      cout << (c < END ? (char)Alpha26::symbol(c) : ' ');
     }
-    uint8_t c = current;
-    cout << (c < END ? (char)(c + 'a') : ' ');
   }
 }
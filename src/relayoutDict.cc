@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "TrieDict.hh"
+
+using namespace std;
+
+/*
+  Lay a TrieHashDict image out again by how a query log uses it. Every word
+  of queries.txt is one lookup, replayed with trace() to count the lookups
+  of each hash map and the reads of each page of the image. relayout() then
+  moves the nodes and text of the busiest hash maps to the front of their
+  sections, the new image is saved, and the log is replayed on it to
+  compare.
+
+  usage: relayoutDict dict.bin queries.txt out.bin [pageKB=2048]
+
+  For both images it reports how many pages of pageKB the log touched and
+  how few of them serve 90% and 99% of the reads, which with 2 MB huge
+  pages is how much has to stay resident. Every lookup must give the same
+  id in both.
+*/
+
+struct Profile {
+  vector<uint64_t> maps;                    // lookups of each hash map
+  unordered_map<uint64_t, uint64_t> pages;  // reads of each page touched
+  vector<uint32_t> ids;                     // of every query, 0 if missing
+};
+
+Profile replay(const TrieHashDict &dict, const vector<string> &queries,
+               uint64_t pageBytes) {
+  Profile p;
+  p.maps.assign(dict.numHashMaps(), 0);
+  const char *base = dict.image().base();
+  auto touch = [&p, base, pageBytes](const void *at, uint32_t bytes) {
+    uint64_t first = ((const char *)at - base) / pageBytes;
+    uint64_t last = ((const char *)at + bytes - 1 - base) / pageBytes;
+    for (uint64_t i = first; i <= last; i++) p.pages[i]++;
+  };
+  for (const string &w : queries) {
+    int32_t k = dict.trace(w.data(), w.size(), touch);
+    if (k >= 0) p.maps[k]++;
+    uint32_t id = 0;
+    dict.get(w.data(), w.size(), id);
+    p.ids.push_back(id);
+  }
+  return p;
+}
+
+// the fewest pages serving fraction of the reads
+uint64_t pagesFor(const vector<uint64_t> &reads, uint64_t total,
+                  double fraction) {
+  uint64_t sum = 0, n = 0;
+  while (n < reads.size() && sum < fraction * total) sum += reads[n++];
+  return n;
+}
+
+void report(const char name[], const Profile &p, uint64_t pageBytes,
+            uint64_t imageBytes) {
+  vector<uint64_t> reads;
+  uint64_t total = 0;
+  for (const auto &page : p.pages) {
+    reads.push_back(page.second);
+    total += page.second;
+  }
+  sort(reads.rbegin(), reads.rend());
+  cout << left << setw(12) << name << right << setw(8) << reads.size()
+       << " of " << setw(6) << (imageBytes + pageBytes - 1) / pageBytes
+       << " pages touched, 90% of reads in " << setw(5)
+       << pagesFor(reads, total, 0.9) << ", 99% in " << setw(5)
+       << pagesFor(reads, total, 0.99) << '\n';
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    cerr << "usage: relayoutDict dict.bin queries.txt out.bin [pageKB]\n";
+    return 1;
+  }
+  uint64_t pageBytes = (argc > 4 ? atoi(argv[4]) : 2048) * 1024ULL;
+  try {
+    vector<string> queries;
+    ifstream f(argv[2]);
+    if (!f) throw "Could not open query log";
+    for (string w; f >> w;) queries.push_back(w);
+
+    TrieHashDict dict(argv[1]);
+    Profile before = replay(dict, queries, pageBytes);
+    dict.relayout(before.maps);
+    dict.save(argv[3]);
+
+    TrieHashDict relaid(argv[3]);
+    if (!relaid.verify()) throw "the new image does not verify";
+    Profile after = replay(relaid, queries, pageBytes);
+    if (after.ids != before.ids) throw "the new image gives different ids";
+
+    uint64_t searched = 0, used = 0;
+    for (uint64_t n : before.maps) {
+      searched += n;
+      used += n != 0;
+    }
+    cout << queries.size() << " queries, " << searched << " searched "
+         << used << " of " << before.maps.size() << " hash maps\n";
+    report(argv[1], before, pageBytes, dict.image().fileSize());
+    report(argv[3], after, pageBytes, relaid.image().fileSize());
+  } catch (const char *msg) {
+    cerr << msg << '\n';
+    return 1;
+  }
+}
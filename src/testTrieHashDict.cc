@@ -2,6 +2,7 @@
 #include <fstream>
 #include <unordered_map>
 
+#include "Benchmark.hh"
 #include "TrieDict.hh"
 
 using namespace std;
@@ -50,12 +51,17 @@ void getunordered_map(uint32_t n) {
 }
 #endif
 
+// a single timed run, see benchTrieHashDict.cc for repeated trials
 template <typename Func>
 void benchmark(const char msg[], Func f, TrieHashDict& dict) {
-  clock_t t0 = clock();
-  f(dict);
-  clock_t t1 = clock();
-  cout << msg << "\t" << (t1 - t0) << '\n';
+  uint64_t check;
+  double ns = Benchmark::time(
+      [&f, &dict] {
+        f(dict);
+        return uint64_t(0);
+      },
+      check);
+  cout << msg << "\t" << ns / 1e6 << " ms\n";
 }
 
 int main() {
@@ -0,0 +1,89 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include "Compressed3letterTrie.hh"
+#include "CorpusPipeline.hh"
+#include "TrieDict.hh"
+
+using namespace std;
+
+/*
+  Turn a text file into word ids with CorpusPipeline: one uint32_t per word
+  of the text, in order, 0 for words not in the dictionary.
+
+  usage: tokenizeCorpus dict.bin corpus.txt [ids.bin] [threads] [chunkKB]
+                        [cacheEntries]
+
+  Without ids.bin (or with -) the ids are only counted, which times the
+  scanning and lookups alone. With threads 0, it runs with 1, 2, 4, ... up to
+  the number of cores to show how throughput scales. With cacheEntries each
+  thread looks words up through a LookupCache of that size, and the hit
+  rate is reported.
+
+  dict.bin is a TrieHashDict image or a compressed 3 letter dictionary,
+  which is looked up in place a chunk at a time with its getBatch.
+*/
+
+template <typename Result>
+void report(uint32_t threads, const Result &r) {
+  cerr << setw(3) << threads << " threads  " << r.words << " words, "
+       << r.found << " found, " << fixed << setprecision(3) << r.seconds
+       << " s, " << setprecision(1) << r.bytes / r.seconds / 1e6 << " MB/s, "
+       << r.words / r.seconds / 1e6 << " M words/s, " << r.steals
+       << " steals";
+  if (r.stats.cacheHits + r.stats.cacheMisses != 0)
+    cerr << ", cache hit rate " << 100 * r.stats.cacheHitRate() << '%';
+  cerr << '\n';
+}
+
+template <typename Dict>
+void run(const Dict &dict, const char corpus[], const char idsFile[],
+         uint32_t threads, uint32_t chunkBytes, uint32_t cacheEntries) {
+  typedef CorpusPipeline<Dict> Pipeline;
+  if (threads == 0) {
+    for (uint32_t t = 1; t <= thread::hardware_concurrency(); t *= 2) {
+      uint64_t sum = 0;
+      Pipeline p(dict, t, chunkBytes, cacheEntries);
+      report(t, p.runFile(corpus, [&sum](const uint32_t ids[], uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) sum += ids[i];
+      }));
+    }
+    return;
+  }
+  FILE *out = idsFile != nullptr ? fopen(idsFile, "wb") : nullptr;
+  if (idsFile != nullptr && out == nullptr) throw "Could not create ids file";
+  Pipeline p(dict, threads, chunkBytes, cacheEntries);
+  bool ok = true;
+  report(threads,
+         p.runFile(corpus, [out, &ok](const uint32_t ids[], uint64_t n) {
+           if (out != nullptr) ok &= fwrite(ids, sizeof(uint32_t), n, out) == n;
+         }));
+  if (out != nullptr && (fclose(out) != 0 || !ok))
+    throw "Could not write ids file";
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    cerr << "usage: tokenizeCorpus dict.bin corpus.txt [ids.bin] [threads] "
+            "[chunkKB] [cacheEntries]\n";
+    return 1;
+  }
+  const char *idsFile = argc > 3 && string(argv[3]) != "-" ? argv[3] : nullptr;
+  uint32_t threads = argc > 4 ? atoi(argv[4]) : thread::hardware_concurrency();
+  uint32_t chunkBytes = (argc > 5 ? atoi(argv[5]) : 1024) * 1024;
+  uint32_t cacheEntries = argc > 6 ? atoi(argv[6]) : 0;
+  try {
+    if (DictFile::kindOf(argv[1]) == DICT_COMPRESSED3) {
+      CompressedDictReader<> dict(argv[1]);
+      run(dict, argv[2], idsFile, threads, chunkBytes, cacheEntries);
+    } else {
+      TrieHashDict dict(argv[1]);
+      run(dict, argv[2], idsFile, threads, chunkBytes, cacheEntries);
+    }
+  } catch (const char *msg) {
+    cerr << msg << '\n';
+    return 1;
+  }
+}